@@ -0,0 +1,77 @@
+#pragma once
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <vector>
+
+#include "config.h"
+
+// Setup shared by the benchmarks that drive the editor itself.
+
+// The view main sets up once the first screen of text is in.
+inline void setUpBenchView(EditorState& st) {
+	st.MaxDisplayedLineCount = (st.screenBuf.height - TPAD - BPAD) / LINE_HEIGHT;
+	st.DisplayedLineCount = std::min(st.Text->size, st.MaxDisplayedLineCount);
+	st.BottomLine = st.DisplayedLineCount - 1;
+	st.CurrLineBuffer = st.Text->getLineBuffer(st.CurrLine);
+}
+
+inline u64 nsSince(std::chrono::steady_clock::time_point start) {
+	return (u64)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Blocky glyphs of roughly the real font's metrics, for trees without media/.
+inline void makeSyntheticFont(EditorState& st) {
+	const u32 cellW = 16, cellH = 30;
+	TgaImageRGBA& image = st.TgaFontImg;
+	image.width = 128 * cellW;
+	image.height = cellH;
+	image.pitch = image.width * 4;
+	image.pixels = new u32[(size_t)image.width * image.height]();
+	for (u32 c = 33; c < 127; c++) {
+		Glyph& g = st.Font.glyphs[c];
+		g.id = (s16)c;
+		g.x = (u16)(c * cellW);
+		g.y = 0;
+		g.w = (u16)(6 + c % 5);
+		g.h = 18;
+		g.xOffset = 1;
+		g.yOffset = 4;
+		g.xAdvance = DEFAULT_CHAR_WIDTH;
+		for (u32 y = 0; y < g.h; y++) {
+			for (u32 x = 0; x < g.w; x++) {
+				u32 alpha = (x * 7 + y * 3 + c) % 5 == 0 ? 0x80u : 0xFFu;
+				image.pixels[g.x + x + (size_t)y * image.width] = (alpha << 24) | 0x00FFFFFFu;
+			}
+		}
+	}
+	st.Font.glyphs[(u32)' '].id = ' ';
+	st.Font.glyphs[(u32)' '].xAdvance = DEFAULT_CHAR_WIDTH;
+}
+
+// The editor's font from media/ when it is there, else the synthetic one.
+inline bool loadBenchFont(EditorState& st) {
+	if (loadFnt(st.Font, FNT_PATH) == OK && loadTga(st.TgaFontImg, TGA_PATH) == OK) {
+		buildGlyphCache(st.Glyphs, st.Font, st.TgaFontImg);
+		return true;
+	}
+	st.Font = {};
+	makeSyntheticFont(st);
+	buildGlyphCache(st.Glyphs, st.Font, st.TgaFontImg);
+	return false;
+}
+
+// {mean, p50, p90, p99, max} of ns as a JSON object, or {} when it is
+// empty; sorts ns.
+inline void printPercentiles(std::vector<u64>& ns) {
+	if (ns.empty()) {
+		std::printf("{}");
+		return;
+	}
+	std::sort(ns.begin(), ns.end());
+	u64 total = 0;
+	for (u64 v : ns) total += v;
+	auto at = [&](f64 q) { return (unsigned long long)ns[std::min(ns.size() - 1, (size_t)(q * (f64)ns.size()))]; };
+	std::printf("{\"mean\": %llu, \"p50\": %llu, \"p90\": %llu, \"p99\": %llu, \"max\": %llu}",
+	            (unsigned long long)(total / ns.size()), at(0.50), at(0.90), at(0.99), (unsigned long long)ns.back());
+}
@@ -0,0 +1,186 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <SDL.h>
+
+#include "benchCommon.h"
+#include "config.h"
+#include "eventHandlers.h"
+#include "fileLoader.h"
+#include "fileSaver.h"
+#include "inputTrace.h"
+#include "rasterPool.h"
+#include "render.h"
+#include "search.h"
+
+// Plays an input trace recorded with RECORD_INPUT_TRACE back through
+// handleEditorEvent as fast as it goes, drawing a frame after every event
+// that changed something, and prints handler, frame and event-to-frame
+// latencies as JSON. The file is copied first so a traced save does not
+// touch it. Highlighting is lexed on this thread, without the worker, so
+// runs are repeatable. Usage: inputReplay trace file [rasterThreads]
+
+static constexpr u32 SLOWEST_EVENTS = 5;
+
+enum EventKind { KindKeyDown, KindText, KindMouse, KindExposed, KindCount };
+
+static const char* const KIND_NAMES[KindCount] = { "keydown", "text", "mouse", "exposed" };
+static const char* const MODE_NAMES[] = { "normal", "insert", "visual", "search" };
+
+static EventKind kindOf(const SDL_Event& e) {
+	if (e.type == SDL_KEYDOWN) return KindKeyDown;
+	if (e.type == SDL_TEXTINPUT) return KindText;
+	if (e.type == SDL_MOUSEBUTTONDOWN) return KindMouse;
+	return KindExposed;
+}
+
+struct SlowEvent {
+	u32 index;
+	ModeType mode;
+	SDL_Event event;
+	u64 latencyNs;
+};
+
+static void printJsonString(const char* str) {
+	std::putchar('"');
+	for (const char* c = str; *c; c++) {
+		if (*c == '"' || *c == '\\') std::printf("\\%c", *c);
+		else if ((u8)*c < 0x20) std::printf("\\u%04x", (u32)(u8)*c);
+		else std::putchar(*c);
+	}
+	std::putchar('"');
+}
+
+static void printInput(const SDL_Event& e) {
+	if (e.type == SDL_KEYDOWN) printJsonString(SDL_GetKeyName(e.key.keysym.sym));
+	else if (e.type == SDL_TEXTINPUT) printJsonString(e.text.text);
+	else if (e.type == SDL_MOUSEBUTTONDOWN) std::printf("\"%d,%d\"", e.button.x, e.button.y);
+	else std::printf("\"\"");
+}
+
+s32 main(s32 argc, char** argv) {
+	if (argc < 3) {
+		std::fprintf(stderr, "usage: inputReplay trace file [rasterThreads]\n");
+		return ERR_UNKNOWN;
+	}
+	std::string tracePath = argv[1];
+	std::filesystem::path source = argv[2];
+	u32 rasterThreads = argc > 3 ? (u32)std::stoul(argv[3]) : std::max(std::thread::hardware_concurrency(), 1u);
+	rasterThreads = std::max(rasterThreads, 1u);
+
+	std::vector<SDL_Event> events;
+	s16 traceResult = readInputTrace(tracePath, events);
+	if (traceResult != OK) {
+		std::fprintf(stderr, "could not read %s\n", tracePath.c_str());
+		return traceResult;
+	}
+
+	// Keeps the extension, which decides whether the copy is highlighted.
+	std::filesystem::path copy = std::filesystem::temp_directory_path() / ("inputReplay_" + source.filename().string());
+	std::error_code error;
+	std::filesystem::copy_file(source, copy, std::filesystem::copy_options::overwrite_existing, error);
+	if (error) {
+		std::fprintf(stderr, "could not copy %s\n", source.c_str());
+		return ERR_FILE_NOT_FOUND;
+	}
+
+	SDL_SetHint(SDL_HINT_VIDEODRIVER, "dummy");
+	if (SDL_Init(SDL_INIT_VIDEO) != 0) {
+		std::fprintf(stderr, "SDL_Init failed: %s\n", SDL_GetError());
+		return ERR_UNKNOWN;
+	}
+
+	EditorState st{};
+	resizeOffscreenBuffer(st.screenBuf, WINDOW_WIDTH, WINDOW_HEIGHT);
+	if (loadFile(st, copy.string()) != OK) {
+		std::fprintf(stderr, "could not load %s\n", copy.c_str());
+		return ERR_FILE_NOT_FOUND;
+	}
+	setUpBenchView(st);
+	bool realFont = loadBenchFont(st);
+	st.rasterPool = startRasterPool(rasterThreads - 1);
+
+	std::vector<DirtyRect> rects;
+	f32 frameMs = 0.0f;
+	auto drawFrame = [&]() {
+		auto start = std::chrono::steady_clock::now();
+		beginFrame(st);
+		renderTextRows(st);
+		renderBottom(st, frameMs);
+		collectDirtyRects(st, rects);
+		endFrame(st);
+		u64 ns = nsSince(start);
+		frameMs = (f32)ns / 1e6f;
+		return ns;
+	};
+	drawFrame();
+
+	std::vector<u64> handlerNs[std::size(MODE_NAMES)][KindCount];
+	std::vector<u64> frameNs;
+	std::vector<u64> latencyNs;
+	std::vector<SlowEvent> slowest;
+	for (u32 i = 0; i < events.size(); i++) {
+		SDL_Event& e = events[i];
+		ModeType mode = st.CurrMode;
+
+		auto start = std::chrono::steady_clock::now();
+		handleEditorEvent(st, e);
+		handlerNs[mode][kindOf(e)].push_back(nsSince(start));
+		pumpFileSave(st);
+		pumpSearch(st);
+		if (hasDamage(st)) frameNs.push_back(drawFrame());
+		u64 latency = nsSince(start);
+		latencyNs.push_back(latency);
+
+		slowest.push_back({ i, mode, e, latency });
+		std::sort(slowest.begin(), slowest.end(), [](const SlowEvent& a, const SlowEvent& b) { return a.latencyNs > b.latencyNs; });
+		if (slowest.size() > SLOWEST_EVENTS) slowest.pop_back();
+	}
+
+	std::printf("{\n  \"trace\": ");
+	printJsonString(tracePath.c_str());
+	std::printf(",\n  \"file\": ");
+	printJsonString(source.c_str());
+	std::printf(",\n  \"lines\": %u,\n  \"events\": %zu,\n  \"frames\": %zu,\n  \"raster_threads\": %u,\n  \"font\": \"%s\"",
+	            st.Text->size, events.size(), frameNs.size(), rasterThreads, realFont ? "media" : "synthetic");
+	std::printf(",\n  \"handlers_ns\": {");
+	bool first = true;
+	for (u32 m = 0; m < std::size(MODE_NAMES); m++) {
+		for (u32 k = 0; k < KindCount; k++) {
+			if (handlerNs[m][k].empty()) continue;
+			std::printf("%s\n    \"%s_%s\": ", first ? "" : ",", MODE_NAMES[m], KIND_NAMES[k]);
+			printPercentiles(handlerNs[m][k]);
+			first = false;
+		}
+	}
+	std::printf("\n  }");
+	if (!frameNs.empty()) {
+		std::printf(",\n  \"frame_ns\": ");
+		printPercentiles(frameNs);
+	}
+	if (!latencyNs.empty()) {
+		std::printf(",\n  \"latency_ns\": ");
+		printPercentiles(latencyNs);
+	}
+	std::printf(",\n  \"slowest\": [");
+	for (u32 i = 0; i < slowest.size(); i++) {
+		const SlowEvent& slow = slowest[i];
+		std::printf("%s\n    {\"index\": %u, \"event\": \"%s_%s\", \"input\": ", i ? "," : "", slow.index,
+		            MODE_NAMES[slow.mode], KIND_NAMES[kindOf(slow.event)]);
+		printInput(slow.event);
+		std::printf(", \"latency_ns\": %llu}", (unsigned long long)slow.latencyNs);
+	}
+	std::printf("\n  ]\n}\n");
+
+	finishFileSave(st);
+	stopRasterPool(st.rasterPool);
+	freeOffscreenBuffer(st.screenBuf);
+	SDL_Quit();
+	std::filesystem::remove(copy);
+	return OK;
+}
@@ -0,0 +1,88 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "lineIndex.h"
+
+// Compares the newline scan kernels against the std::getline loop that
+// loadFile used before. Usage: lineIndexBench [megabytes]
+
+static constexpr u32 REPEATS = 5;
+
+static std::string makeDocument(size_t bytes) {
+	std::string doc;
+	doc.reserve(bytes + 4096);
+	u32 seed = 0x2545F491;
+	while (doc.size() < bytes) {
+		seed ^= seed << 13;
+		seed ^= seed >> 17;
+		seed ^= seed << 5;
+		// Mostly code-sized lines, with the occasional blank or very long one.
+		u32 len = seed % 97;
+		if ((seed >> 8) % 64 == 0) len = 0;
+		if ((seed >> 16) % 1024 == 0) len = 4096 + seed % 8192;
+		for (u32 i = 0; i < len; i++) doc.push_back((char)('a' + (i + seed) % 26));
+		doc.push_back('\n');
+	}
+	return doc;
+}
+
+template <typename F>
+static f64 bestSeconds(F&& run) {
+	f64 best = 1e30;
+	for (u32 i = 0; i < REPEATS; i++) {
+		auto start = std::chrono::steady_clock::now();
+		run();
+		std::chrono::duration<f64> elapsed = std::chrono::steady_clock::now() - start;
+		best = std::min(best, elapsed.count());
+	}
+	return best;
+}
+
+static void report(const char* name, size_t bytes, u64 lines, f64 seconds) {
+	std::printf("%-10s %8.2f GB/s  %10.2f ms  %llu lines\n", name,
+	            (f64)bytes / seconds / 1e9, seconds * 1e3, (unsigned long long)lines);
+}
+
+s32 main(s32 argc, char** argv) {
+	size_t megabytes = argc > 1 ? (size_t)std::stoul(argv[1]) : 256;
+	std::string doc = makeDocument(megabytes << 20);
+
+	std::filesystem::path path = std::filesystem::temp_directory_path() / "lineIndexBench.txt";
+	{
+		std::ofstream out(path, std::ios::binary);
+		out.write(doc.data(), (std::streamsize)doc.size());
+	}
+
+	u64 getlineLines = 0;
+	f64 getlineSeconds = bestSeconds([&]() {
+		std::ifstream file(path);
+		std::string line;
+		getlineLines = 0;
+		while (std::getline(file, line)) getlineLines++;
+	});
+	report("getline", doc.size(), getlineLines, getlineSeconds);
+	std::filesystem::remove(path);
+
+	std::vector<u64> newlines;
+	newlines.reserve(getlineLines + 1);
+	for (NewlineScanKernel kernel : { ScanScalar, ScanSSE2, ScanAVX2, ScanNEON }) {
+		if (!isNewlineScanKernelSupported(kernel)) continue;
+		f64 seconds = bestSeconds([&]() {
+			newlines.clear();
+			indexNewlines(doc.data(), doc.size(), 0, newlines, kernel);
+		});
+		report(newlineScanKernelName(kernel), doc.size(), newlines.size(), seconds);
+		if (newlines.size() != getlineLines) {
+			std::fprintf(stderr, "%s found %zu newlines, expected %llu\n",
+			             newlineScanKernelName(kernel), newlines.size(), (unsigned long long)getlineLines);
+			return ERR_UNKNOWN;
+		}
+	}
+
+	return OK;
+}
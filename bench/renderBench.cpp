@@ -0,0 +1,241 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <SDL.h>
+
+#include "benchCommon.h"
+#include "config.h"
+#include "eventHandlers.h"
+#include "fileLoader.h"
+#include "rasterPool.h"
+#include "render.h"
+
+// Drives the frame functions main calls against the offscreen buffer alone,
+// with SDL on its dummy video driver so insert mode works without a window,
+// and prints per-function frame costs as JSON.
+// Usage: renderBench [frames] [rasterThreads]
+
+static constexpr u32 WARMUP_FRAMES = 16;
+
+enum Phase {
+	PhaseBeginFrame, PhaseTextRows, PhaseBottom, PhaseDirtyRects, PhaseEndFrame, PhaseFrame, PhaseCount
+};
+
+static const char* const PHASE_NAMES[PhaseCount] = {
+	"beginFrame", "renderTextRows", "renderBottom", "collectDirtyRects", "endFrame", "frame"
+};
+
+struct Document {
+	const char* name;
+	const char* fileName;
+	std::string text;
+};
+
+static u32 nextRandom(u32& seed) {
+	seed ^= seed << 13;
+	seed ^= seed >> 17;
+	seed ^= seed << 5;
+	return seed;
+}
+
+// Code-like lines with comments, strings and indentation, so the highlighter
+// has something to colour.
+static std::string makeCode(u32 lines) {
+	static const char* const WORDS[] = {
+		"int", "return", "value", "if", "for", "while", "const", "auto", "count", "line", "struct", "buffer"
+	};
+	std::string doc;
+	u32 seed = 0x2545F491;
+	for (u32 i = 0; i < lines; i++) {
+		u32 r = nextRandom(seed);
+		doc.append(4 * (r % 4), ' ');
+		if (r % 11 == 0) doc += "// ";
+		u32 words = 2 + (r >> 8) % 8;
+		for (u32 w = 0; w < words; w++) {
+			doc += WORDS[nextRandom(seed) % std::size(WORDS)];
+			doc += (seed % 5 == 0) ? " = 42; " : " ";
+		}
+		if (r % 7 == 0) doc += "\"a string literal\";";
+		doc.push_back('\n');
+	}
+	return doc;
+}
+
+static std::string makeLongLines(u32 lines, u32 length) {
+	std::string doc;
+	u32 seed = 0x9E3779B9;
+	for (u32 i = 0; i < lines; i++) {
+		for (u32 c = 0; c < length; c++) {
+			u32 r = nextRandom(seed);
+			doc.push_back(r % 9 == 0 ? ' ' : (char)('a' + r % 26));
+		}
+		doc.push_back('\n');
+	}
+	return doc;
+}
+
+static std::string makeTabbed(u32 lines) {
+	std::string doc;
+	u32 seed = 0x85EBCA6B;
+	for (u32 i = 0; i < lines; i++) {
+		u32 r = nextRandom(seed);
+		doc.append(1 + r % 6, '\t');
+		for (u32 field = 0; field < 4 + (r >> 8) % 6; field++) {
+			doc += "field";
+			doc.push_back('\t');
+		}
+		doc.push_back('\n');
+	}
+	return doc;
+}
+
+struct Samples {
+	std::vector<u64> ns[PhaseCount];
+};
+
+// One frame as main draws it, minus the texture upload and present.
+static void drawFrame(EditorState& st, std::vector<DirtyRect>& rects, f32& frameMs, Samples* samples) {
+	auto frameStart = std::chrono::steady_clock::now();
+	u64 ns[PhaseCount];
+
+	auto start = frameStart;
+	beginFrame(st);
+	ns[PhaseBeginFrame] = nsSince(start);
+
+	start = std::chrono::steady_clock::now();
+	renderTextRows(st);
+	ns[PhaseTextRows] = nsSince(start);
+
+	start = std::chrono::steady_clock::now();
+	renderBottom(st, frameMs);
+	ns[PhaseBottom] = nsSince(start);
+
+	start = std::chrono::steady_clock::now();
+	collectDirtyRects(st, rects);
+	ns[PhaseDirtyRects] = nsSince(start);
+
+	start = std::chrono::steady_clock::now();
+	endFrame(st);
+	ns[PhaseEndFrame] = nsSince(start);
+
+	ns[PhaseFrame] = nsSince(frameStart);
+	frameMs = (f32)ns[PhaseFrame] / 1e6f;
+	if (samples) for (u32 p = 0; p < PhaseCount; p++) samples->ns[p].push_back(ns[p]);
+}
+
+enum Scenario { ScrollScenario, TypeScenario, RedrawScenario, ScenarioCount };
+
+static const char* const SCENARIO_NAMES[ScenarioCount] = { "scroll", "type", "redraw" };
+
+static void stepScenario(EditorState& st, Scenario scenario, u32 frame) {
+	switch (scenario) {
+		case ScrollScenario: {
+			if (st.BottomLine + 1 >= st.Text->size) jumpToLine(st, 0);
+			else {
+				jumpToBottomOfWindow(st);
+				moveDownOneLine(st);
+			}
+		} break;
+		case TypeScenario: {
+			SDL_Event e;
+			std::memset(&e, 0, sizeof(e));
+			e.type = SDL_TEXTINPUT;
+			e.text.text[0] = "type "[frame % 5];
+			handleInsertModeTextInput(st, e);
+		} break;
+		case RedrawScenario: markAllDirty(st); break;
+		case ScenarioCount: break;
+	}
+}
+
+// Loads the document fresh for each scenario so typing never carries over.
+static s32 runScenario(const Document& doc, const std::filesystem::path& path, Scenario scenario,
+                       u32 frames, u32 rasterThreads, bool& realFont, bool& first) {
+	EditorState st{};
+	resizeOffscreenBuffer(st.screenBuf, WINDOW_WIDTH, WINDOW_HEIGHT);
+	if (loadFile(st, path.string()) != OK) return ERR_FILE_NOT_FOUND;
+	setUpBenchView(st);
+	realFont = loadBenchFont(st);
+	st.rasterPool = startRasterPool(rasterThreads - 1);
+
+	if (scenario == TypeScenario) {
+		moveCursorTo(st, st.DisplayedLineCount / 2, 0);
+		enterInsertMode(st);
+	}
+
+	std::vector<DirtyRect> rects;
+	f32 frameMs = 0.0f;
+	Samples samples;
+	for (u32 frame = 0; frame < WARMUP_FRAMES + frames; frame++) {
+		stepScenario(st, scenario, frame);
+		drawFrame(st, rects, frameMs, frame < WARMUP_FRAMES ? nullptr : &samples);
+	}
+
+	std::printf("%s\n    {\"document\": \"%s\", \"scenario\": \"%s\", \"lines\": %u, \"frames\": %u, \"phases_ns\": {",
+	            first ? "" : ",", doc.name, SCENARIO_NAMES[scenario], st.Text->size, frames);
+	for (u32 p = 0; p < PhaseCount; p++) {
+		std::printf("%s\n      \"%s\": ", p ? "," : "", PHASE_NAMES[p]);
+		printPercentiles(samples.ns[p]);
+	}
+	std::printf("\n    }}");
+	first = false;
+
+	if (st.CurrMode == InsertMode) exitInsertMode(st);
+	stopRasterPool(st.rasterPool);
+	freeOffscreenBuffer(st.screenBuf);
+	delete[] st.TgaFontImg.pixels;
+	delete st.Text;
+	return OK;
+}
+
+s32 main(s32 argc, char** argv) {
+	u32 frames = argc > 1 ? (u32)std::stoul(argv[1]) : 500;
+	u32 rasterThreads = argc > 2 ? (u32)std::stoul(argv[2]) : std::max(std::thread::hardware_concurrency(), 1u);
+	rasterThreads = std::max(rasterThreads, 1u);
+	if (frames == 0) {
+		std::fprintf(stderr, "usage: renderBench [frames] [rasterThreads], with frames > 0\n");
+		return ERR_UNKNOWN;
+	}
+
+	SDL_SetHint(SDL_HINT_VIDEODRIVER, "dummy");
+	if (SDL_Init(SDL_INIT_VIDEO) != 0) {
+		std::fprintf(stderr, "SDL_Init failed: %s\n", SDL_GetError());
+		return ERR_UNKNOWN;
+	}
+
+	Document docs[] = {
+		{ "code", "renderBench_code.cpp", makeCode(20000) },
+		{ "long_lines", "renderBench_long.txt", makeLongLines(200, 10000) },
+		{ "tabs", "renderBench_tabs.txt", makeTabbed(20000) },
+		{ "many_lines", "renderBench_many.cpp", makeCode(2000000) },
+	};
+
+	bool realFont = false;
+	bool first = true;
+	std::printf("{\n  \"raster_threads\": %u,\n  \"width\": %u,\n  \"height\": %u,\n  \"results\": [",
+	            rasterThreads, WINDOW_WIDTH, WINDOW_HEIGHT);
+	s32 result = OK;
+	for (const Document& doc : docs) {
+		std::filesystem::path path = std::filesystem::temp_directory_path() / doc.fileName;
+		{
+			std::ofstream out(path, std::ios::binary);
+			out.write(doc.text.data(), (std::streamsize)doc.text.size());
+		}
+		for (u32 s = 0; s < ScenarioCount && result == OK; s++) {
+			result = runScenario(doc, path, (Scenario)s, frames, rasterThreads, realFont, first);
+		}
+		std::filesystem::remove(path);
+		if (result != OK) break;
+	}
+	std::printf("\n  ],\n  \"font\": \"%s\"\n}\n", realFont ? "media" : "synthetic");
+
+	SDL_Quit();
+	return result;
+}
@@ -0,0 +1,191 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "lineIndex.h"
+#include "textBuffer.h"
+
+// Times the TextBuffer and LineBuffer operations the editor leans on, at a
+// few document sizes, so buffer changes can be checked against numbers.
+// Usage: textBufferBench [maxLines]
+
+static constexpr u32 REPEATS = 3;
+static constexpr u32 LOOKUPS = 1000000;
+static constexpr u32 EDITS = 100000;
+static constexpr u32 SIZES[] = { 1000, 100000, 10000000 };
+
+// Keeps the lookup loop from being optimized away.
+static volatile u64 sink;
+
+static u32 nextRandom(u32& seed) {
+	seed ^= seed << 13;
+	seed ^= seed >> 17;
+	seed ^= seed << 5;
+	return seed;
+}
+
+static std::string makeDocument(u32 lines) {
+	std::string doc;
+	doc.reserve((size_t)lines * 33);
+	u32 seed = 0x2545F491;
+	for (u32 i = 0; i < lines; i++) {
+		u32 len = nextRandom(seed) % 64;
+		for (u32 c = 0; c < len; c++) doc.push_back((char)('a' + (c + seed) % 26));
+		doc.push_back('\n');
+	}
+	return doc;
+}
+
+static f64 secondsSince(std::chrono::steady_clock::time_point start) {
+	std::chrono::duration<f64> elapsed = std::chrono::steady_clock::now() - start;
+	return elapsed.count();
+}
+
+// What loadFile does minus the editor state around it.
+static TextBuffer* loadText(const std::string& path) {
+	TextBuffer* text = new TextBuffer{};
+	if (mapFile(text->mapping, path) != OK) {
+		delete text;
+		return nullptr;
+	}
+	std::vector<u64> newlines;
+	indexNewlines(text->mapping.data, text->mapping.size, 0, newlines);
+	text->appendBorrowedLines(0, newlines.data(), newlines.size());
+	return text;
+}
+
+static void report(u32 lines, const char* name, f64 seconds, u32 ops) {
+	std::printf("%10u lines  %-18s %12.1f ns/op  %10.2f ms total\n", lines, name, seconds * 1e9 / ops, seconds * 1e3);
+}
+
+// Lines picked up front so the timed loops measure the edit alone.
+static std::vector<LineBuffer*> pickLines(TextBuffer& text, u32 count, u32 seed) {
+	std::vector<LineBuffer*> lines(count);
+	for (LineBuffer*& lb : lines) lb = text.getLineBuffer(nextRandom(seed) % text.size);
+	return lines;
+}
+
+enum EditPosition { AtHead, AtMiddle, AtTail };
+
+static u32 insertPosition(const LineBuffer* lb, EditPosition where) {
+	if (where == AtHead) return 0;
+	return where == AtMiddle ? lb->size / 2 : lb->size;
+}
+
+// Where insertPosition put the character, given the line with it.
+static u32 removePosition(const LineBuffer* lb, EditPosition where) {
+	if (where == AtHead) return 0;
+	return where == AtMiddle ? (lb->size - 1) / 2 : lb->size - 1;
+}
+
+// EDITS characters typed into random lines and then deleted again, each at
+// the line's head, middle or tail. Lines are detached first so the copy out
+// of the mapping is not part of either number.
+static void benchCharEdits(TextBuffer& text, EditPosition where, const char* appendName, const char* removeName) {
+	std::vector<LineBuffer*> lines = pickLines(text, EDITS, 0x85EBCA6B + where);
+	for (LineBuffer* lb : lines) lb->detach();
+
+	auto start = std::chrono::steady_clock::now();
+	for (LineBuffer* lb : lines) lb->appendAt('x', insertPosition(lb, where));
+	report(text.size, appendName, secondsSince(start), EDITS);
+
+	start = std::chrono::steady_clock::now();
+	for (size_t i = lines.size(); i > 0; i--) lines[i - 1]->removeAt(removePosition(lines[i - 1], where));
+	report(text.size, removeName, secondsSince(start), EDITS);
+}
+
+static bool benchSize(u32 lines) {
+	std::string doc = makeDocument(lines);
+	std::filesystem::path path = std::filesystem::temp_directory_path() / "textBufferBench.txt";
+	{
+		std::ofstream out(path, std::ios::binary);
+		out.write(doc.data(), (std::streamsize)doc.size());
+	}
+	doc.clear();
+	doc.shrink_to_fit();
+
+	// Load and teardown are repeated on fresh buffers; the edits below run
+	// once on the last one.
+	TextBuffer* text = nullptr;
+	f64 loadSeconds = 1e30;
+	f64 teardownSeconds = 1e30;
+	for (u32 r = 0; r < REPEATS; r++) {
+		auto start = std::chrono::steady_clock::now();
+		TextBuffer* loaded = loadText(path.string());
+		loadSeconds = std::min(loadSeconds, secondsSince(start));
+		if (!loaded) {
+			std::filesystem::remove(path);
+			return false;
+		}
+		if (r + 1 == REPEATS) {
+			text = loaded;
+			break;
+		}
+		start = std::chrono::steady_clock::now();
+		delete loaded;
+		teardownSeconds = std::min(teardownSeconds, secondsSince(start));
+	}
+	report(lines, "load", loadSeconds, lines);
+	report(lines, "teardown", teardownSeconds, lines);
+
+	u32 seed = 0x9E3779B9;
+	u64 checksum = 0;
+	auto start = std::chrono::steady_clock::now();
+	for (u32 i = 0; i < LOOKUPS; i++) checksum += text->getLineBuffer(nextRandom(seed) % text->size)->size;
+	report(lines, "getLineBuffer", secondsSince(start), LOOKUPS);
+
+	benchCharEdits(*text, AtHead, "appendAt head", "removeAt head");
+	benchCharEdits(*text, AtMiddle, "appendAt middle", "removeAt middle");
+	benchCharEdits(*text, AtTail, "appendAt tail", "removeAt tail");
+
+	// Each batch is undone untimed, so every row runs on a document within
+	// a tenth of its labelled size.
+	u32 lineEdits = std::min(EDITS, std::max(lines / 10, 1u));
+	std::vector<u32> indices(lineEdits);
+	for (u32& index : indices) index = nextRandom(seed);
+
+	start = std::chrono::steady_clock::now();
+	for (u32& index : indices) {
+		index %= text->size + 1;
+		text->insertAtIndex(index);
+	}
+	report(lines, "insertAtIndex", secondsSince(start), lineEdits);
+	for (size_t i = indices.size(); i > 0; i--) text->removeAtIndex(indices[i - 1]);
+
+	// A line split as the editor does it: a new line after the current one
+	// receives everything past the cursor.
+	for (u32& index : indices) index = nextRandom(seed);
+	start = std::chrono::steady_clock::now();
+	for (u32& index : indices) {
+		index %= text->size;
+		LineBuffer* lb = text->getLineBuffer(index);
+		text->insertAtIndex(index + 1);
+		lb->splitAt(lb->size / 2, lb->next);
+	}
+	report(lines, "splitAt", secondsSince(start), lineEdits);
+	for (size_t i = indices.size(); i > 0; i--) text->joinAtIndex(indices[i - 1]);
+
+	start = std::chrono::steady_clock::now();
+	delete text;
+	report(lines, "teardown edited", secondsSince(start), lines);
+
+	std::filesystem::remove(path);
+	sink = checksum;
+	return true;
+}
+
+s32 main(s32 argc, char** argv) {
+	u32 maxLines = argc > 1 ? (u32)std::stoul(argv[1]) : SIZES[std::size(SIZES) - 1];
+	for (u32 lines : SIZES) {
+		if (lines > maxLines) break;
+		if (!benchSize(lines)) {
+			std::printf("could not map the benchmark file\n");
+			return ERR_FILE_NOT_FOUND;
+		}
+	}
+	return OK;
+}
@@ -0,0 +1,171 @@
+#pragma once
+#include <cstddef>
+#include <new>
+#include <utility>
+#include <vector>
+
+#include "commonTypes.h"
+#include "diagnostics.h"
+
+// Fixed-size object pool. Objects are bumped out of large chunks, recycled
+// through an intrusive free list, and released together in O(chunks)
+// without running their destructors.
+template <typename T, u32 OBJECTS_PER_CHUNK = 4096>
+struct Pool {
+	union Slot {
+		Slot* nextFree;
+		alignas(T) u8 storage[sizeof(T)];
+	};
+	static_assert(alignof(Slot) <= __STDCPP_DEFAULT_NEW_ALIGNMENT__);
+
+	std::vector<Slot*> chunks;
+	Slot* bump = nullptr;
+	Slot* bumpEnd = nullptr;
+	Slot* freeList = nullptr;
+	size_t liveCount = 0;
+
+	Pool() = default;
+	Pool(const Pool&) = delete;
+	Pool& operator=(const Pool&) = delete;
+	~Pool() { release(); }
+
+	template <typename... Args>
+	T* create(Args&&... args) {
+		Slot* slot = freeList;
+		if (slot) {
+			freeList = slot->nextFree;
+		} else {
+			if (bump == bumpEnd) {
+				bump = new Slot[OBJECTS_PER_CHUNK];
+				bumpEnd = bump + OBJECTS_PER_CHUNK;
+				chunks.push_back(bump);
+			}
+			slot = bump++;
+		}
+		liveCount++;
+		return new (slot->storage) T(std::forward<Args>(args)...);
+	}
+
+	void destroy(T* object) {
+		object->~T();
+		Slot* slot = (Slot*)(void*)object;
+		slot->nextFree = freeList;
+		freeList = slot;
+		liveCount--;
+	}
+
+	void release() {
+		for (Slot* chunk : chunks) delete[] chunk;
+		chunks.clear();
+		bump = bumpEnd = freeList = nullptr;
+		liveCount = 0;
+	}
+};
+
+// Size-classed arena for line text. Requests are rounded up to a power of
+// two; every class bumps out of the same chunk and keeps its own free list.
+// Blocks above the largest class get their own allocation, tracked on an
+// intrusive list so release() stays O(chunks + large blocks).
+struct TextArena {
+	static constexpr u32 MIN_CLASS_SHIFT = 4;
+	static constexpr u32 MAX_CLASS_SHIFT = 16;
+	static constexpr u32 CLASS_COUNT = MAX_CLASS_SHIFT - MIN_CLASS_SHIFT + 1;
+	static constexpr size_t CHUNK_SIZE = (size_t)1 << 20;
+
+	struct FreeBlock {
+		FreeBlock* next;
+	};
+
+	struct alignas(16) LargeBlock {
+		LargeBlock* prev;
+		LargeBlock* next;
+	};
+
+	FreeBlock* freeLists[CLASS_COUNT]{};
+	std::vector<char*> chunks;
+	char* bump = nullptr;
+	char* bumpEnd = nullptr;
+	LargeBlock* large = nullptr;
+
+	TextArena() = default;
+	TextArena(const TextArena&) = delete;
+	TextArena& operator=(const TextArena&) = delete;
+	~TextArena() { release(); }
+
+	// Capacity actually handed out for a request of `size` bytes.
+	static u32 roundUp(u32 size) {
+		u32 capacity = 1u << MIN_CLASS_SHIFT;
+		while (capacity < size) capacity <<= 1;
+		return capacity;
+	}
+
+	// Returns a block of roundUp(capacity) bytes and stores that size back.
+	char* allocate(u32& capacity) {
+		capacity = roundUp(capacity);
+		if (capacity > (1u << MAX_CLASS_SHIFT)) {
+			LargeBlock* block = (LargeBlock*)::operator new(sizeof(LargeBlock) + capacity);
+			block->prev = nullptr;
+			block->next = large;
+			if (large) large->prev = block;
+			large = block;
+			return (char*)(block + 1);
+		}
+
+		u32 sizeClass = classOf(capacity);
+		if (FreeBlock* block = freeLists[sizeClass]) {
+			freeLists[sizeClass] = block->next;
+			return (char*)block;
+		}
+
+		if ((size_t)(bumpEnd - bump) < capacity) {
+			// The tail of the old chunk is handed to the free lists, not lost.
+			while ((size_t)(bumpEnd - bump) >= (1u << MIN_CLASS_SHIFT)) {
+				u32 tail = 1u << MIN_CLASS_SHIFT;
+				while (tail * 2 <= (size_t)(bumpEnd - bump) && tail * 2 < capacity) tail *= 2;
+				deallocate(bump, tail);
+				bump += tail;
+			}
+			bump = new char[CHUNK_SIZE];
+			bumpEnd = bump + CHUNK_SIZE;
+			chunks.push_back(bump);
+		}
+
+		char* text = bump;
+		bump += capacity;
+		return text;
+	}
+
+	void deallocate(char* text, u32 capacity) {
+		DIAG_ASSERT(capacity == roundUp(capacity), "TextArena deallocate with unrounded capacity");
+		if (capacity > (1u << MAX_CLASS_SHIFT)) {
+			LargeBlock* block = (LargeBlock*)(void*)text - 1;
+			if (block->prev) block->prev->next = block->next;
+			else large = block->next;
+			if (block->next) block->next->prev = block->prev;
+			::operator delete(block);
+			return;
+		}
+
+		u32 sizeClass = classOf(capacity);
+		FreeBlock* block = (FreeBlock*)(void*)text;
+		block->next = freeLists[sizeClass];
+		freeLists[sizeClass] = block;
+	}
+
+	void release() {
+		for (char* chunk : chunks) delete[] chunk;
+		chunks.clear();
+		while (large) {
+			LargeBlock* next = large->next;
+			::operator delete(large);
+			large = next;
+		}
+		for (FreeBlock*& list : freeLists) list = nullptr;
+		bump = bumpEnd = nullptr;
+	}
+
+private:
+	static u32 classOf(u32 capacity) {
+		return (u32)__builtin_ctz(capacity) - MIN_CLASS_SHIFT;
+	}
+};
@@ -8,6 +8,8 @@ constexpr u32 WHITE       = 0xFFFFFFFF;
 constexpr u32 GRAY_10     = 0xFF1A1A1A;
 constexpr u32 SELECTED_LINE_BG = 0xFF0F0F0F;
 constexpr u32 BOTTOM_BAR_BG = 0xFF0F0F0F;
+constexpr u32 SEARCH_MATCH_BG = 0xFF3A3A14;
+constexpr u32 CURRENT_MATCH_BG = 0xFF6E6E1E;
 constexpr u32 GRAY_20     = 0xFF333333;
 constexpr u32 GRAY_30     = 0xFF4D4D4D;
 constexpr u32 GRAY_40     = 0xFF666666;
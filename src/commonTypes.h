@@ -19,3 +19,4 @@ constexpr s16 ERR_UNKNOWN = -1;
 constexpr s16 ERR_FILE_NOT_FOUND = -2;
 constexpr s16 ERR_UNSUPPORTED = -3;
 constexpr s16 ERR_EOF = -4;
+constexpr s16 ERR_IO = -5;
@@ -1,9 +1,15 @@
 #pragma once
 #include <string>
+#include <vector>
 
 #include "commonTypes.h"
 #include "textBuffer.h"
 #include "font.h"
+#include "glyphCache.h"
+#include "layoutCache.h"
+#include "undoJournal.h"
+#include "search.h"
+#include "syntaxHighlight.h"
 
 
 constexpr u32 WINDOW_WIDTH = 1920;
@@ -21,6 +27,49 @@ constexpr u32 FPS_BPAD = 20;
 constexpr u32 MODE_LPAD = 25;
 constexpr u32 MODE_BPAD = 20;
 
+// Frames are only drawn when something changed. FRAME_CAP_FPS bounds how
+// often that can happen (0 = no cap); IDLE_WAIT_MS is how long the loop
+// sleeps in SDL_WaitEventTimeout when nothing is pending.
+constexpr bool VSYNC_ENABLED = true;
+constexpr u32 FRAME_CAP_FPS = 144;
+constexpr u32 IDLE_WAIT_MS = 1000;
+constexpr u32 LOAD_TICK_MS = 50;
+
+// Bytes each raster pool participant reads per background search slice;
+// the loop runs one every SEARCH_TICK_MS while the index is being built.
+constexpr u64 SEARCH_SLICE_BYTES = 4 * 1024 * 1024;
+constexpr u32 SEARCH_TICK_MS = 1;
+
+// The highlight worker is handed HIGHLIGHT_CHUNK_LINES lines per job, at
+// most HIGHLIGHT_AHEAD_CHUNKS jobs past what the UI has taken in, and lexes
+// one chunk past the bottom of the screen. The loop checks for results every
+// HIGHLIGHT_TICK_MS while any are due. An edit re-lexes up to
+// HIGHLIGHT_SYNC_LINES lines on the UI thread before the worker takes over.
+constexpr u32 HIGHLIGHT_CHUNK_LINES = 32768;
+constexpr u32 HIGHLIGHT_AHEAD_CHUNKS = 4;
+constexpr u32 HIGHLIGHT_TICK_MS = 8;
+constexpr u32 HIGHLIGHT_SYNC_LINES = 256;
+
+// Text rows are rasterized by RASTER_THREADS workers plus the UI thread
+// (0 = one per extra core, 1 = single-threaded). Frames with fewer dirty
+// rows than RASTER_MIN_PARALLEL_ROWS stay on the UI thread.
+constexpr u32 RASTER_THREADS = 0;
+constexpr u32 RASTER_MIN_PARALLEL_ROWS = 8;
+
+// Frames the profiler keeps for its overlay in builds with PROFILING.
+constexpr u32 PROFILE_FRAMES = 256;
+
+// F4 starts and stops a Chrome trace written to TRACE_PATH. Each thread
+// buffers up to TRACE_THREAD_EVENTS events between flushes; more are
+// dropped and counted.
+const char* const TRACE_PATH = "media/trace.json";
+constexpr u32 TRACE_THREAD_EVENTS = 1 << 15;
+constexpr u32 TRACE_FLUSH_MS = 10;
+
+// Undo history is trimmed from the oldest edit once records and their text
+// take more than this.
+constexpr size_t UNDO_JOURNAL_BYTES = 64 * 1024 * 1024;
+
 constexpr u32 DEFAULT_CHAR_WIDTH = 12;
 constexpr u32 TAB_SIZE = 4;
 
@@ -31,13 +80,47 @@ const char* const FNT_PATH = "media/SpaceMono_Regular_18.fnt";
 const char* const TGA_PATH = "media/SpaceMono_Regular_18.tga";
 const char* const FILE_PATH = "media/text.txt";
 
+// Writes every key, text and click event to INPUT_TRACE_PATH for
+// bench/inputReplay to play back.
+constexpr bool RECORD_INPUT_TRACE = false;
+const char* const INPUT_TRACE_PATH = "media/input.trace";
+
 enum ModeType {
-	NormalMode = 0, InsertMode = 1, VisualMode = 2
+	NormalMode = 0, InsertMode = 1, VisualMode = 2, SearchMode = 3
 };
 
+struct FileLoad;
+struct FileSave;
+struct RecoveryLog;
+struct RasterPool;
+struct InputRecorder;
+
+// pitch is rounded up to a whole number of cache lines and pixels is
+// cache-line aligned, so no two rows share a line.
 struct OffscreenBuffer {
 	u32 width = 0, height = 0, pitch = 0;
 	u32* pixels = nullptr;
+
+	u32* row(u32 y) const { return pixels + (size_t)y * (pitch / 4); }
+};
+
+// Which text rows changed since the last frame, plus the view state that
+// frame showed so cursor moves and scrolls can be detected without every
+// handler reporting them.
+struct FrameDamage {
+	std::vector<u8> rows;
+	bool full = true;
+
+	u32 lastTopLine = 0;
+	u32 lastCurrLine = 0;
+	u32 lastCursorPos = 0;
+	u32 lastScrollX = 0;
+	u32 lastDisplayedLineCount = 0;
+	ModeType lastMode = NormalMode;
+	bool lastIsDirty = false;
+	bool lastSaving = false;
+	u64 lastSearchRevision = 0;
+	u64 lastHighlightRevision = 0;
 };
 
 struct EditorState {
@@ -47,6 +130,7 @@ struct EditorState {
 	u32 BottomLine = 0;
 	u32 CurrLine = 0;
 	u32 CursorPos = 0;
+	u32 ScrollX = 0;
 
 	ModeType CurrMode = NormalMode;
 
@@ -56,9 +140,20 @@ struct EditorState {
 	u32 FontSize = 5;
 	Font Font{};
 	TgaImageRGBA TgaFontImg{};
+	GlyphCache Glyphs{};
+	LayoutCache Layouts{};
+	UndoJournal Undo{};
+	SearchState Search{};
+	SyntaxHighlight Syntax{};
 
 	OffscreenBuffer screenBuf{};
+	FrameDamage damage{};
 	std::string currentFilePath;
 	std::string currentFileName;
 	bool isDirty = false;
+	FileLoad* pendingLoad = nullptr;
+	FileSave* pendingSave = nullptr;
+	RecoveryLog* recovery = nullptr;
+	RasterPool* rasterPool = nullptr;
+	InputRecorder* inputRecorder = nullptr;
 };
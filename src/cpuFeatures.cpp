@@ -0,0 +1,20 @@
+#include "cpuFeatures.h"
+
+static CpuFeatures detectCpuFeatures() {
+	CpuFeatures features{};
+#if defined(__x86_64__) || defined(_M_X64)
+	features.sse2 = true;
+#if defined(__GNUC__) || defined(__clang__)
+	__builtin_cpu_init();
+	features.avx2 = __builtin_cpu_supports("avx2");
+#endif
+#elif defined(__aarch64__) || defined(_M_ARM64)
+	features.neon = true;
+#endif
+	return features;
+}
+
+const CpuFeatures& getCpuFeatures() {
+	static const CpuFeatures features = detectCpuFeatures();
+	return features;
+}
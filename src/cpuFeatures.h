@@ -0,0 +1,11 @@
+#pragma once
+
+// Instruction sets the SIMD kernels may dispatch to. SSE2 is baseline on
+// x86-64 and NEON on arm64; AVX2 is probed at runtime.
+struct CpuFeatures {
+	bool sse2 = false;
+	bool avx2 = false;
+	bool neon = false;
+};
+
+const CpuFeatures& getCpuFeatures();
@@ -14,6 +14,7 @@ namespace {
 	std::array<std::array<char, kKeyLen>, kMaxKeys> g_keys{};
 	size_t g_keyCount = 0;
 	size_t g_keyIndex = 0;
+	void (*g_abortHook)() = nullptr;
 
 	void storeKey(std::string_view key) {
 		if (key.empty()) return;
@@ -63,6 +64,10 @@ void diagRecordKeyChar(char c) {
 	}
 }
 
+void diagSetAbortHook(void (*hook)()) {
+	g_abortHook = hook;
+}
+
 [[noreturn]] void diagAbort(const char* expr, const char* file, int line, const char* msg) {
 	std::fprintf(stderr, "Fatal error: %s\n", msg ? msg : "unknown");
 	std::fprintf(stderr, "Assertion: %s\n", expr ? expr : "(none)");
@@ -71,5 +76,6 @@ void diagRecordKeyChar(char c) {
 	writeRecentKeys(stderr);
 	std::fputc('\n', stderr);
 	std::fflush(stderr);
+	if (g_abortHook) g_abortHook();
 	std::abort();
 }
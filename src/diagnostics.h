@@ -3,6 +3,8 @@
 
 void diagRecordKey(const char* key);
 void diagRecordKeyChar(char c);
+// Runs inside diagAbort before the process goes down.
+void diagSetAbortHook(void (*hook)());
 [[noreturn]] void diagAbort(const char* expr, const char* file, int line, const char* msg);
 
 #if defined(RELEASE)
@@ -1,17 +1,19 @@
 #include "eventHandlers.h"
 #include "diagnostics.h"
+#include "fileLoader.h"
+#include "fileSaver.h"
+#include "render.h"
+#include "profiler.h"
+#include <algorithm>
 #include <print>
+#include <string>
 
 static void recordKeyEvent(SDL_Event& e);
 static void markDirty(EditorState& st);
+static void markDirtyFrom(EditorState& st, u32 line);
 
 SDL_Texture* resizeWindow(EditorState& st, u32 w, u32 h, SDL_Renderer* ren) {
-	st.screenBuf.width = w;
-	st.screenBuf.height = h;
-	st.screenBuf.pitch = w * 4;
-
-	SDL_free(st.screenBuf.pixels);
-	st.screenBuf.pixels = (u32*)SDL_malloc((size_t)w * (size_t)h * 4);
+	resizeOffscreenBuffer(st.screenBuf, w, h);
 
 	return SDL_CreateTexture(ren, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_STREAMING, w, h);
 }
@@ -73,6 +75,36 @@ void jumpToLine(EditorState& st, u32 line) {
 	else if (st.CursorPos > lb->size - 1) st.CursorPos = lb->size - 1;
 }
 
+void moveCursorTo(EditorState& st, u32 line, u32 pos) {
+	st.DisplayedLineCount = std::min(st.Text->size, st.MaxDisplayedLineCount);
+	if (st.TopLine + st.DisplayedLineCount > st.Text->size) st.TopLine = st.Text->size - st.DisplayedLineCount;
+	st.BottomLine = st.TopLine + st.DisplayedLineCount - 1;
+
+	if (line < st.TopLine || line > st.BottomLine) jumpToLine(st, line);
+	st.CurrLine = line;
+	st.CurrLineBuffer = st.Text->getLineBuffer(line);
+
+	u32 size = st.CurrLineBuffer->size;
+	st.CursorPos = size == 0 ? 0 : std::min(pos, size - 1);
+}
+
+void handleMouseClick(EditorState& st, s32 x, s32 y) {
+	if (y < (s32)TPAD || x < 0) return;
+	u32 row = ((u32)y - TPAD) / LINE_HEIGHT;
+	if (row >= st.DisplayedLineCount) return;
+
+	st.CurrLine = st.TopLine + row;
+	st.CurrLineBuffer = st.Text->getLineBuffer(st.CurrLine);
+
+	u32 textLeft = LPAD + TEXT_LPAD;
+	u32 lineX = (u32)x < textLeft ? st.ScrollX : (u32)x - textLeft + st.ScrollX;
+	LineBuffer* lb = st.CurrLineBuffer;
+	u32 column = columnAtX(getLineLayout(st.Layouts, st.Glyphs, lb), lineX);
+
+	u32 last = st.CurrMode == InsertMode ? lb->size : (lb->size ? lb->size - 1 : 0);
+	st.CursorPos = std::min(column, last);
+}
+
 void jumpToStartOfLine(EditorState& st) {
 	st.CursorPos = 0;
 }
@@ -86,7 +118,7 @@ void jumpToFirstNonWhitespace(EditorState& st) {
 
 	u32 pos = 0;
 	while (pos < lb->size) {
-		char c = lb->text[pos];
+		char c = lb->at(pos);
 		if (c != ' ' && c != '\t') break;
 		pos += 1;
 	}
@@ -164,7 +196,7 @@ void jumpToNextWord(EditorState& st) {
 		st.CursorPos = 0;
 		if (lb->size == 0) return;
 
-		while (lb->text[st.CursorPos] == '\t') {
+		while (lb->at(st.CursorPos) == '\t') {
 			if (advance(st) == ERR_EOF) return;
 		}
 		return;
@@ -172,20 +204,20 @@ void jumpToNextWord(EditorState& st) {
 	
 	// If the current char is alpha-numeric, increase the cursor position until a symbol is reached
 	// else (current char is symbol), increment cursor pos
-	char currChar = lb->text[st.CursorPos];
+	char currChar = lb->at(st.CursorPos);
 	if (isKeyword(currChar)) {
 		while (isKeyword(currChar)) {
 			if (advance(st) == ERR_EOF) return;
-			currChar = lb->text[st.CursorPos];
+			currChar = lb->at(st.CursorPos);
 		}
 	}
 	else st.CursorPos += 1;
 
 	// Do not end on an empty space or tab if you started on a alpha-numeric char or symbol
-	currChar = lb->text[st.CursorPos];
+	currChar = lb->at(st.CursorPos);
 	while (currChar == ' ' ||  currChar == '\t') {
 		if (advance(st) == ERR_EOF) return;
-		currChar = lb->text[st.CursorPos];
+		currChar = lb->at(st.CursorPos);
 	}
 	return;
 }
@@ -203,7 +235,7 @@ void jumpToPrevWord(EditorState& st) {
 		if (lb->size == 0) return;
 
 
-		while (lb->text[st.CursorPos] == '\t') {
+		while (lb->at(st.CursorPos) == '\t') {
 			if (retreat(st) == ERR_EOF) return;
 		}
 		return;
@@ -214,38 +246,38 @@ void jumpToPrevWord(EditorState& st) {
 	// decrease until you reach a symbol or the start of a new string of keywords
 	// 2) you are in not at the first char in a string of keywords:
 	// decrease until you reach the start of the string of keywords
-	char currChar = lb->text[st.CursorPos];
+	char currChar = lb->at(st.CursorPos);
 	if (isKeyword(currChar)) {
 		if (retreat(st) == ERR_EOF) return;
-		currChar = lb->text[st.CursorPos];
+		currChar = lb->at(st.CursorPos);
 
 		while (currChar == ' ' ||  currChar == '\t') {
 			if (retreat(st) == ERR_EOF) return;
-			currChar = lb->text[st.CursorPos];
+			currChar = lb->at(st.CursorPos);
 		}
 
 		if (!isKeyword(currChar)) return;
 		while (isKeyword(currChar)) {
 			if (st.CursorPos == 0) return;
 			if (retreat(st) == ERR_EOF) return;
-			currChar = lb->text[st.CursorPos];
+			currChar = lb->at(st.CursorPos);
 		}
 		advance(st);
 	}
 	// else decrease until you are at a symbol or start of a string of keywords
 	else {
 		st.CursorPos -= 1;
-		currChar = lb->text[st.CursorPos];
+		currChar = lb->at(st.CursorPos);
 		while (currChar == ' ' ||  currChar == '\t') {
 			if (retreat(st) == ERR_EOF) return;
-			currChar = lb->text[st.CursorPos];
+			currChar = lb->at(st.CursorPos);
 		}
 
 		if (isKeyword(currChar)) {
 			while (isKeyword(currChar)) {
 				if (st.CursorPos == 0) return;
 				if (retreat(st) == ERR_EOF) return;
-				currChar = lb->text[st.CursorPos];
+				currChar = lb->at(st.CursorPos);
 			}
 			advance(st);
 		}
@@ -265,45 +297,45 @@ void jumpToEndOfNextWord(EditorState& st) {
 		st.CursorPos = 0;
 		if (lb->size == 0) return;
 
-		while (lb->text[st.CursorPos] == '\t') {
+		while (lb->at(st.CursorPos) == '\t') {
 			if (advance(st) == ERR_EOF) return;
 		}
 		return;
 	}
 	
 	// If the current char is alpha-numeric, increase the cursor position until a symbol is reached
-	char currChar = lb->text[st.CursorPos];
+	char currChar = lb->at(st.CursorPos);
 	if (isKeyword(currChar)) {
 		if (advance(st) == ERR_EOF) return;
-		currChar = lb->text[st.CursorPos];
+		currChar = lb->at(st.CursorPos);
 
 		while (currChar == ' ' ||  currChar == '\t') {
 			if (advance(st) == ERR_EOF) return;
-			currChar = lb->text[st.CursorPos];
+			currChar = lb->at(st.CursorPos);
 		}
 
 		if (!isKeyword(currChar)) return;
 		while (isKeyword(currChar)) {
 			if (st.CursorPos == 0) return;
 			if (advance(st) == ERR_EOF) return;
-			currChar = lb->text[st.CursorPos];
+			currChar = lb->at(st.CursorPos);
 		}
 		retreat(st);
 	}
 	// else (current char is symbol), increment cursor pos
 	else {
 		st.CursorPos += 1;
-		currChar = lb->text[st.CursorPos];
+		currChar = lb->at(st.CursorPos);
 		while (currChar == ' ' ||  currChar == '\t') {
 			if (advance(st) == ERR_EOF) return;
-			currChar = lb->text[st.CursorPos];
+			currChar = lb->at(st.CursorPos);
 		}
 
 		if (isKeyword(currChar)) {
 			while (isKeyword(currChar)) {
 				if (st.CursorPos == 0) return;
 				if (advance(st) == ERR_EOF) return;
-				currChar = lb->text[st.CursorPos];
+				currChar = lb->at(st.CursorPos);
 			}
 			retreat(st);
 		}
@@ -349,6 +381,7 @@ char shift(char c) {
 
 void enterInsertMode(EditorState& st, InsertionPosition pos) {
 	st.CurrMode = InsertMode;
+	beginUndoGroup(st);
 	SDL_StartTextInput();
 	SDL_FlushEvent(SDL_TEXTINPUT);
 
@@ -362,11 +395,25 @@ void enterInsertMode(EditorState& st, InsertionPosition pos) {
 
 void exitInsertMode(EditorState& st) {
 	st.CurrMode = NormalMode;
+	endUndoGroup(st);
 	auto& lb = st.CurrLineBuffer;
 	if (st.CursorPos == lb->size && st.CursorPos != 0) st.CursorPos-=1;
 	SDL_StopTextInput();
 }
 
+void enterSearchMode(EditorState& st) {
+	st.CurrMode = SearchMode;
+	SDL_StartTextInput();
+	SDL_FlushEvent(SDL_TEXTINPUT);
+	beginSearch(st);
+}
+
+void exitSearchMode(EditorState& st, bool accept) {
+	st.CurrMode = NormalMode;
+	finishSearch(st, accept);
+	SDL_StopTextInput();
+}
+
 char eventToChar(SDL_Event& e) {
 	char c = 0;
 	switch (e.key.keysym.sym) {
@@ -469,23 +516,38 @@ void recordKeyEvent(SDL_Event& e) {
 
 static void markDirty(EditorState& st) {
 	st.isDirty = true;
+	markLineDirty(st, st.CurrLine);
 }
 
+// Inserting or splitting a line shifts every row below it.
+static void markDirtyFrom(EditorState& st, u32 line) {
+	st.isDirty = true;
+	markLinesDirtyFrom(st, line);
+}
+
+// The new line joins the insert session it opens, so one undo removes both.
 void insertLineAtCurrLine(EditorState& st) {
-	st.Text->insertAtLine(st.CurrLineBuffer->next);
-	markDirty(st);
+	finishFileLoad(st);
+	beginUndoGroup(st);
+	recordInsertLine(st, st.CurrLine + 1);
+	st.Text->insertAtIndex(st.CurrLine + 1);
+	markDirtyFrom(st, st.CurrLine);
 	if (st.DisplayedLineCount != st.MaxDisplayedLineCount) {
 		st.DisplayedLineCount += 1;
 		st.BottomLine += 1;
 	}
 	moveDownOneLine(st);
 	enterInsertMode(st);
+	endUndoGroup(st);
 }
 
 void insertLineAboveCurrLine(EditorState& st) {
+	finishFileLoad(st);
+	beginUndoGroup(st);
 	auto& lb = st.CurrLineBuffer;
-	st.Text->insertAtLine(lb);
-	markDirty(st);
+	recordInsertLine(st, st.CurrLine);
+	st.Text->insertAtIndex(st.CurrLine);
+	markDirtyFrom(st, st.CurrLine);
 	if (st.DisplayedLineCount != st.MaxDisplayedLineCount) {
 		st.DisplayedLineCount += 1;
 		st.BottomLine += 1;
@@ -496,12 +558,15 @@ void insertLineAboveCurrLine(EditorState& st) {
 	}
 	else st.CurrLineBuffer = lb->prev;
 	enterInsertMode(st);
+	endUndoGroup(st);
 }
 
 void splitLineAtCursor(EditorState& st) {
+	finishFileLoad(st);
 	auto& lb = st.CurrLineBuffer;
-	st.Text->insertAtLine(st.CurrLineBuffer->next);
-	markDirty(st);
+	recordSplitLine(st, st.CurrLine, std::min(st.CursorPos, lb->size));
+	st.Text->insertAtIndex(st.CurrLine + 1);
+	markDirtyFrom(st, st.CurrLine);
 	if (st.DisplayedLineCount != st.MaxDisplayedLineCount) {
 		st.DisplayedLineCount += 1;
 		st.BottomLine += 1;
@@ -511,6 +576,31 @@ void splitLineAtCursor(EditorState& st) {
 	st.CursorPos = 0;
 }
 
+void pasteText(EditorState& st, std::string_view clip) {
+	std::string text;
+	text.reserve(clip.size());
+	for (char c : clip) if (c != '\r') text.push_back(c);
+	if (text.empty() || !st.CurrLineBuffer) return;
+
+	u32 column = std::min(st.CursorPos, st.CurrLineBuffer->size);
+	size_t lastNewline = text.rfind('\n');
+	if (lastNewline == std::string::npos) {
+		recordInsertText(st, st.CurrLine, column, text);
+		st.CurrLineBuffer->insertText(column, text);
+		st.CursorPos = column + (u32)text.size();
+		markDirty(st);
+		return;
+	}
+
+	finishFileLoad(st);
+	recordInsertBlock(st, st.CurrLine, column, text);
+	st.Text->insertBlock(st.CurrLine, column, text);
+	markDirtyFrom(st, st.CurrLine);
+	u32 lastLine = st.CurrLine + (u32)std::count(text.begin(), text.end(), '\n');
+	moveCursorTo(st, lastLine, 0);
+	st.CursorPos = (u32)(text.size() - lastNewline - 1);
+}
+
 void handleNormalModeEvent(EditorState& st, SDL_Event& e) {
 	recordKeyEvent(e);
 	char c = eventToChar(e);
@@ -536,7 +626,7 @@ void handleNormalModeEvent(EditorState& st, SDL_Event& e) {
 		case 'l': moveRight(st); break;
 		case '0': jumpToStartOfLine(st); break;
 		case '^': jumpToFirstNonWhitespace(st); break;
-		case 'G': jumpToLine(st, st.Text->size-1); break;
+		case 'G': finishFileLoad(st); jumpToLine(st, st.Text->size-1); break;
 		case 'H': jumpToTopOfWindow(st); break;
 		case 'M': jumpToMiddleOfWindow(st); break;
 		case 'L': jumpToBottomOfWindow(st); break;
@@ -549,7 +639,17 @@ void handleNormalModeEvent(EditorState& st, SDL_Event& e) {
 		case 'v': st.CurrMode = VisualMode; break;
 		case 'o': { insertLineAtCurrLine(st); } break;
 		case 'O': { insertLineAboveCurrLine(st); } break;
+		case 'u': undoEdit(st); break;
+		case 'r': if (e.key.keysym.mod & KMOD_CTRL) redoEdit(st); break;
+		case 's': if (e.key.keysym.mod & KMOD_CTRL) saveFile(st, st.currentFilePath); break;
+		case '/': enterSearchMode(st); break;
+		case 'n': searchNext(st, true); break;
+		case 'N': searchNext(st, false); break;
 		case 'x': { 
+			if (st.CursorPos < lb->size) {
+				char removed = lb->at(st.CursorPos);
+				recordRemoveText(st, st.CurrLine, st.CursorPos, std::string_view(&removed, 1));
+			}
 			lb->removeAt(st.CursorPos);
 			markDirty(st);
 			if (st.CursorPos != 0 && st.CursorPos == lb->size) st.CursorPos -= 1;
@@ -567,6 +667,8 @@ void handleInsertModeKeyDown(EditorState& st, SDL_Event& e) {
 		case SDLK_ESCAPE: exitInsertMode(st); break;
 		case SDLK_BACKSPACE: {
 			if (st.CursorPos != 0) {
+				char removed = lb->at(st.CursorPos - 1);
+				recordRemoveText(st, st.CurrLine, st.CursorPos - 1, std::string_view(&removed, 1));
 				lb->removeAt(st.CursorPos - 1);
 				st.CursorPos -= 1;
 				markDirty(st);
@@ -574,7 +676,13 @@ void handleInsertModeKeyDown(EditorState& st, SDL_Event& e) {
 		} break;
 		case SDLK_RETURN:
 		case SDLK_RETURN2: splitLineAtCursor(st); break;
-		case SDLK_TAB: lb->appendAt('\t', st.CursorPos); st.CursorPos += 1; markDirty(st); break;
+		case SDLK_TAB: recordInsertText(st, st.CurrLine, st.CursorPos, "\t"); lb->appendAt('\t', st.CursorPos); st.CursorPos += 1; markDirty(st); break;
+		case SDLK_v: {
+			if (!(e.key.keysym.mod & KMOD_CTRL)) break;
+			char* clip = SDL_GetClipboardText();
+			if (clip) pasteText(st, clip);
+			SDL_free(clip);
+		} break;
 
 		default: break;
 	}
@@ -590,6 +698,7 @@ void handleInsertModeTextInput(EditorState& st, SDL_Event& e) {
 	if (!st.CurrLineBuffer) return;
 	auto& lb = st.CurrLineBuffer;
 
+	recordInsertText(st, st.CurrLine, st.CursorPos, e.text.text);
 	for (u16 i = 0; e.text.text[i] != '\0'; i++) {
 		lb->appendAt(e.text.text[i], st.CursorPos);
 		st.CursorPos++;
@@ -597,6 +706,31 @@ void handleInsertModeTextInput(EditorState& st, SDL_Event& e) {
 	if (e.text.text[0] != '\0') markDirty(st);
 }
 
+void handleSearchModeKeyDown(EditorState& st, SDL_Event& e) {
+	recordKeyEvent(e);
+	switch (e.key.keysym.sym) {
+		case SDLK_ESCAPE: exitSearchMode(st, false); break;
+		case SDLK_RETURN:
+		case SDLK_RETURN2: exitSearchMode(st, true); break;
+		case SDLK_BACKSPACE: {
+			if (st.Search.query.empty()) {
+				exitSearchMode(st, false);
+				break;
+			}
+			std::string query = st.Search.query;
+			query.pop_back();
+			setSearchQuery(st, query);
+		} break;
+		default: break;
+	}
+}
+
+void handleSearchModeTextInput(EditorState& st, SDL_Event& e) {
+	recordKeyEvent(e);
+	if (e.text.text[0] == '\0') return;
+	setSearchQuery(st, st.Search.query + e.text.text);
+}
+
 void handleVisualModeEvent(EditorState& st, SDL_Event& e) {
 	recordKeyEvent(e);
 	switch (e.key.keysym.sym) {
@@ -604,3 +738,47 @@ void handleVisualModeEvent(EditorState& st, SDL_Event& e) {
 		default: break;
 	}
 }
+
+void handleEditorEvent(EditorState& st, SDL_Event& e) {
+#if PROFILING
+	if (e.type == SDL_KEYDOWN && e.key.keysym.sym == SDLK_F3) {
+		toggleProfilerOverlay();
+		markAllDirty(st);
+		return;
+	}
+	if (e.type == SDL_KEYDOWN && e.key.keysym.sym == SDLK_F4) {
+		requestTraceToggle();
+		return;
+	}
+#endif
+	TRACE_SCOPE("handleEditorEvent");
+
+	if (e.type == SDL_WINDOWEVENT && e.window.event == SDL_WINDOWEVENT_EXPOSED) {
+		markAllDirty(st);
+	}
+
+	if (e.type == SDL_MOUSEBUTTONDOWN && e.button.button == SDL_BUTTON_LEFT) {
+		handleMouseClick(st, e.button.x, e.button.y);
+	}
+
+	if (st.CurrMode == InsertMode) {
+		if (e.type == SDL_TEXTINPUT) {
+			handleInsertModeTextInput(st, e);
+		} else if (e.type == SDL_KEYDOWN) {
+			handleInsertModeKeyDown(st, e);
+		}
+	}
+	else if (st.CurrMode == SearchMode) {
+		if (e.type == SDL_TEXTINPUT) {
+			handleSearchModeTextInput(st, e);
+		} else if (e.type == SDL_KEYDOWN) {
+			handleSearchModeKeyDown(st, e);
+		}
+	}
+	else {
+		if (e.type == SDL_KEYDOWN) {
+			if (st.CurrMode == NormalMode) handleNormalModeEvent(st, e);
+			else if (st.CurrMode == VisualMode) handleVisualModeEvent(st, e);
+		}
+	}
+}
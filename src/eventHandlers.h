@@ -1,6 +1,7 @@
 #pragma once
 #include <cassert>
 #include <cstring>
+#include <string_view>
 
 #include <SDL.h>
 
@@ -20,6 +21,9 @@ void moveUpOneLine(EditorState& st);
 
 void jumpToLine(EditorState& st, u32 line);
 
+// Moves the cursor, scrolling only when `line` is off screen.
+void moveCursorTo(EditorState& st, u32 line, u32 pos);
+
 void jumpToStartOfLine(EditorState& st);
 
 void jumpToFirstNonWhitespace(EditorState& st);
@@ -42,16 +46,36 @@ void enterInsertMode(EditorState& st, InsertionPosition pos = InsertAtCursor);
 
 void exitInsertMode(EditorState& st);
 
+void enterSearchMode(EditorState& st);
+
+// Enter keeps the cursor on the match, Escape puts it back.
+void exitSearchMode(EditorState& st, bool accept);
+
 char eventToChar(SDL_Event& e);
 
 void insertLineAtCurrLine(EditorState& st);
 
 void insertLineAboveCurrLine(EditorState& st);
 
+// Inserts at the cursor and leaves it after the text. Text with newlines is
+// one block edit, undone in one step.
+void pasteText(EditorState& st, std::string_view text);
+
+// Moves the cursor to the character under window position (x, y).
+void handleMouseClick(EditorState& st, s32 x, s32 y);
+
 void handleNormalModeEvent(EditorState& st, SDL_Event& e);
 
 void handleInsertModeKeyDown(EditorState& st, SDL_Event& e);
 
 void handleInsertModeTextInput(EditorState& st, SDL_Event& e);
 
+void handleSearchModeKeyDown(EditorState& st, SDL_Event& e);
+
+void handleSearchModeTextInput(EditorState& st, SDL_Event& e);
+
 void handleVisualModeEvent(EditorState& st, SDL_Event& e);
+
+// Routes an input event to the handlers of the current mode. Window resizes
+// and quitting are left to the caller.
+void handleEditorEvent(EditorState& st, SDL_Event& e);
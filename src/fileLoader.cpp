@@ -1,8 +1,15 @@
-#include <fstream>
 #include <string>
+#include <vector>
 
 #include "fileLoader.h"
 #include "commonTypes.h"
+#include "fileSaver.h"
+#include "lineIndex.h"
+#include "traceExport.h"
+
+// The first chunk is small so the first screen is ready almost at once.
+constexpr u64 FIRST_LOAD_CHUNK = 64 * 1024;
+constexpr u64 LOAD_CHUNK = 8 * 1024 * 1024;
 
 static std::string extractFileName(const std::string& path) {
 	size_t sep = path.find_last_of("/\\");
@@ -10,23 +17,157 @@ static std::string extractFileName(const std::string& path) {
 	return path.substr(sep + 1);
 }
 
+static void installText(EditorState& st, TextBuffer* newText, const std::string& path) {
+	cancelFileLoad(st);
+	// A save still writing holds a snapshot of the old text.
+	finishFileSave(st);
+	clearUndoJournal(st.Undo);
+	cancelHighlightJobs(st.Syntax);
+	delete st.Text;
+	st.Text = newText;
+	st.currentFilePath = path;
+	st.currentFileName = extractFileName(path);
+	st.isDirty = false;
+	resetSyntaxHighlight(st.Syntax, st.currentFileName);
+}
+
+static void finishText(TextBuffer* text, u64 lineStart) {
+	const MappedFile& mapping = text->mapping;
+	if (lineStart < mapping.size) text->appendBorrowed(mapping.data + lineStart, (u32)(mapping.size - lineStart));
+	if (text->size == 0) text->append();
+	text->finalNewline = mapping.size > 0 && mapping.data[mapping.size - 1] == '\n';
+}
+
 s32 loadFile(EditorState& st, const std::string& path) {
+	TRACE_SCOPE("loadFile");
+
+	TextBuffer* newText = new TextBuffer{};
+	s16 mapResult = mapFile(newText->mapping, path);
+	if (mapResult != OK) {
+		delete newText;
+		return mapResult;
+	}
+
+	// Lines point straight into the mapping; nothing is copied until edited.
+	std::vector<u64> newlines;
+	indexNewlines(newText->mapping.data, newText->mapping.size, 0, newlines);
+	newText->appendBorrowedLines(0, newlines.data(), newlines.size());
+	finishText(newText, newlines.empty() ? 0 : newlines.back() + 1);
+
+	installText(st, newText, path);
+	return OK;
+}
+
+static void scanFile(FileLoad* load, const char* data) {
+	TRACE_THREAD_NAME("file loader");
+	std::vector<u64> chunk;
+	u64 offset = 0;
+	u64 chunkSize = FIRST_LOAD_CHUNK;
 
-	std::ifstream file(path);
+	while (offset < load->fileSize && !load->cancelled.load(std::memory_order_relaxed)) {
+		u64 len = std::min(chunkSize, load->fileSize - offset);
+		chunk.clear();
+		{
+			TRACE_SCOPE("indexNewlines");
+			indexNewlines(data + offset, (size_t)len, offset, chunk);
+		}
+		offset += len;
+		chunkSize = LOAD_CHUNK;
 
-	if (!file) return ERR_FILE_NOT_FOUND;
+		{
+			std::lock_guard<std::mutex> guard(load->lock);
+			load->pending.insert(load->pending.end(), chunk.begin(), chunk.end());
+		}
+		load->bytesScanned.store(offset, std::memory_order_relaxed);
+		load->ready.notify_one();
+	}
+
+	{
+		std::lock_guard<std::mutex> guard(load->lock);
+		load->finished = true;
+	}
+	load->ready.notify_one();
+}
+
+s32 beginLoadFile(EditorState& st, const std::string& path) {
+	TRACE_SCOPE("beginLoadFile");
 
-	std::string line;
 	TextBuffer* newText = new TextBuffer{};
-	while (std::getline(file, line)) {
-		newText->append(line, (u32)line.size());
+	s16 mapResult = mapFile(newText->mapping, path);
+	if (mapResult != OK) {
+		delete newText;
+		return mapResult;
 	}
 
-	delete st.Text;
-	st.Text = newText;
-	st.currentFilePath = path;
-	st.currentFileName = extractFileName(path);
-	st.isDirty = false;
+	installText(st, newText, path);
 
+	FileLoad* load = new FileLoad{};
+	load->fileSize = newText->mapping.size;
+	load->worker = std::thread(scanFile, load, newText->mapping.data);
+	st.pendingLoad = load;
 	return OK;
 }
+
+void pumpFileLoad(EditorState& st) {
+	FileLoad* load = st.pendingLoad;
+	if (!load) return;
+
+	bool finished;
+	{
+		std::lock_guard<std::mutex> guard(load->lock);
+		std::swap(load->pending, load->draining);
+		finished = load->finished;
+	}
+
+	if (!load->draining.empty()) {
+		TRACE_SCOPE("appendLoadedLines");
+		st.Text->appendBorrowedLines(load->nextLineStart, load->draining.data(), load->draining.size());
+		load->nextLineStart = load->draining.back() + 1;
+		load->draining.clear();
+	}
+
+	if (finished) {
+		finishText(st.Text, load->nextLineStart);
+		load->worker.join();
+		delete load;
+		st.pendingLoad = nullptr;
+	}
+
+	// Lines that arrive while the window is not yet full become visible.
+	if (st.DisplayedLineCount < st.MaxDisplayedLineCount && st.Text->size > 0) {
+		st.DisplayedLineCount = std::min(st.Text->size, st.MaxDisplayedLineCount);
+		st.BottomLine = st.TopLine + st.DisplayedLineCount - 1;
+		if (st.BottomLine >= st.Text->size) st.BottomLine = st.Text->size - 1;
+	}
+}
+
+void waitForLoadedLines(EditorState& st, u32 lines) {
+	while (st.pendingLoad && st.Text->size < lines) {
+		FileLoad* load = st.pendingLoad;
+		{
+			std::unique_lock<std::mutex> guard(load->lock);
+			load->ready.wait(guard, [load]() { return !load->pending.empty() || load->finished; });
+		}
+		pumpFileLoad(st);
+	}
+}
+
+void finishFileLoad(EditorState& st) {
+	waitForLoadedLines(st, UINT32_MAX);
+}
+
+void cancelFileLoad(EditorState& st) {
+	FileLoad* load = st.pendingLoad;
+	if (!load) return;
+
+	load->cancelled.store(true, std::memory_order_relaxed);
+	load->worker.join();
+	delete load;
+	st.pendingLoad = nullptr;
+}
+
+f32 fileLoadProgress(const EditorState& st) {
+	FileLoad* load = st.pendingLoad;
+	if (!load || load->fileSize == 0) return 1.0f;
+	return (f32)load->bytesScanned.load(std::memory_order_relaxed) / (f32)load->fileSize;
+}
@@ -1,7 +1,45 @@
 #pragma once
 
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
 #include <string>
+#include <thread>
+#include <vector>
 
 #include "config.h"
 
+// Background line indexing for a file that is already mapped into st.Text.
+// The worker only produces newline offsets; the UI thread owns the
+// TextBuffer and drains them in pumpFileLoad.
+struct FileLoad {
+	std::thread worker;
+	std::mutex lock;
+	std::condition_variable ready;
+	std::vector<u64> pending;
+	bool finished = false;
+
+	std::atomic<u64> bytesScanned{0};
+	std::atomic<bool> cancelled{false};
+
+	std::vector<u64> draining;
+	u64 fileSize = 0;
+	u64 nextLineStart = 0;
+};
+
 s32 loadFile(EditorState& st, const std::string& path);
+
+s32 beginLoadFile(EditorState& st, const std::string& path);
+
+void pumpFileLoad(EditorState& st);
+
+void waitForLoadedLines(EditorState& st, u32 lines);
+
+// Streamed lines are appended at the end of st.Text, so any edit that adds or
+// removes lines, or moves to the last one, waits for the rest of the file
+// first; otherwise the lines still to come would land after the user's.
+void finishFileLoad(EditorState& st);
+
+void cancelFileLoad(EditorState& st);
+
+f32 fileLoadProgress(const EditorState& st);
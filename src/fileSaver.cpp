@@ -0,0 +1,194 @@
+#include <cerrno>
+#include <climits>
+#include <cstdio>
+#include <string>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include "fileSaver.h"
+#include "fileLoader.h"
+#include "traceExport.h"
+#include "recoveryLog.h"
+
+// One writev takes at most SAVE_IOV_BATCH spans and SAVE_MAX_WRITE bytes;
+// some systems reject a call whose total does not fit in an int.
+#ifdef IOV_MAX
+constexpr u32 SAVE_IOV_BATCH = IOV_MAX < 1024 ? IOV_MAX : 1024;
+#else
+constexpr u32 SAVE_IOV_BATCH = 1024;
+#endif
+constexpr size_t SAVE_MAX_WRITE = 1u << 30;
+
+static const char NEWLINE = '\n';
+
+struct IovBatch {
+	iovec spans[SAVE_IOV_BATCH];
+	u32 count = 0;
+};
+
+static s16 writeAll(int fd, iovec* iov, u32 count) {
+	while (count > 0) {
+		u32 n = 1;
+		size_t total = iov[0].iov_len;
+		while (n < count && total + iov[n].iov_len <= SAVE_MAX_WRITE) total += iov[n++].iov_len;
+
+		ssize_t written = writev(fd, iov, (int)n);
+		if (written < 0 && errno == EINTR) continue;
+		if (written <= 0) return ERR_IO;
+
+		// Skip what went out; a short write leaves part of one span behind.
+		size_t left = (size_t)written;
+		while (count > 0 && left >= iov->iov_len) {
+			left -= iov->iov_len;
+			iov++;
+			count--;
+		}
+		if (count > 0) {
+			iov->iov_base = (char*)iov->iov_base + left;
+			iov->iov_len -= left;
+		}
+	}
+	return OK;
+}
+
+// Spans that continue the previous one are merged, so runs of lines still
+// borrowed from the mapping go out as one large span.
+static s16 pushSpan(int fd, IovBatch& batch, const char* data, size_t len) {
+	if (len == 0) return OK;
+	if (batch.count > 0) {
+		iovec& last = batch.spans[batch.count - 1];
+		if ((const char*)last.iov_base + last.iov_len == data && last.iov_len + len <= SAVE_MAX_WRITE) {
+			last.iov_len += len;
+			return OK;
+		}
+	}
+	if (batch.count == SAVE_IOV_BATCH) {
+		s16 result = writeAll(fd, batch.spans, batch.count);
+		batch.count = 0;
+		if (result != OK) return result;
+	}
+	batch.spans[batch.count++] = { (void*)data, len };
+	return OK;
+}
+
+static s16 writeText(const FileSave* save) {
+	IovBatch batch;
+	const TextSnapshot& snapshot = save->snapshot;
+	const char* mappingEnd = save->mappingData + save->mappingSize;
+
+	SnapshotCursor cursor;
+	seekSnapshotLine(cursor, snapshot, 0);
+	for (u32 i = 0; i < snapshot.size; i++) {
+		std::string_view line = nextSnapshotLine(cursor);
+		if (pushSpan(save->fd, batch, line.data(), line.size()) != OK) return ERR_IO;
+		if (i + 1 == snapshot.size && !save->finalNewline) break;
+
+		// A line still borrowed from the mapping is followed by its own
+		// newline there; pointing at that one keeps the span contiguous.
+		const char* newline = &NEWLINE;
+		const char* end = line.data() + line.size();
+		if (end >= save->mappingData && end < mappingEnd && *end == '\n') newline = end;
+		if (pushSpan(save->fd, batch, newline, 1) != OK) return ERR_IO;
+	}
+	return writeAll(save->fd, batch.spans, batch.count);
+}
+
+static std::string directoryOf(const std::string& path) {
+	size_t sep = path.find_last_of('/');
+	if (sep == std::string::npos) return ".";
+	if (sep == 0) return "/";
+	return path.substr(0, sep);
+}
+
+// fsync alone can leave the data in the drive's cache on macOS.
+static int syncFile(int fd) {
+#ifdef F_FULLFSYNC
+	if (fcntl(fd, F_FULLFSYNC) == 0) return 0;
+#endif
+	return fsync(fd);
+}
+
+static void runFileSave(FileSave* save) {
+	TRACE_THREAD_NAME("file saver");
+	TRACE_SCOPE("runFileSave");
+	s32 result = writeText(save);
+	releaseSnapshot(save->snapshot);
+	if (result == OK && syncFile(save->fd) != 0) result = ERR_IO;
+	if (close(save->fd) != 0) result = ERR_IO;
+	save->fd = -1;
+
+	if (result == OK && rename(save->tempPath.c_str(), save->path.c_str()) != 0) result = ERR_IO;
+	if (result == OK) {
+		// Makes the rename itself durable.
+		int dir = open(directoryOf(save->path).c_str(), O_RDONLY);
+		if (dir >= 0) {
+			fsync(dir);
+			close(dir);
+		}
+	}
+	else {
+		unlink(save->tempPath.c_str());
+	}
+
+	save->result = result;
+	save->finished.store(true, std::memory_order_release);
+}
+
+s32 saveFile(EditorState& st, const std::string& path) {
+	TRACE_SCOPE("saveFile");
+	if (path.empty()) return ERR_FILE_NOT_FOUND;
+
+	// Renames have to land in order, and a streaming load is not all of
+	// the text yet.
+	finishFileSave(st);
+	waitForLoadedLines(st, UINT32_MAX);
+
+	mode_t mode = 0644;
+	struct stat info{};
+	if (stat(path.c_str(), &info) == 0) mode = info.st_mode & 07777;
+
+	std::string tempPath = path + ".save";
+	int fd = open(tempPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, mode);
+	if (fd < 0) return ERR_IO;
+	fchmod(fd, mode);
+
+	FileSave* save = new FileSave{};
+	save->fd = fd;
+	save->tempPath = tempPath;
+	save->path = path;
+	save->snapshot = takeSnapshot(*st.Text);
+	save->mappingData = st.Text->mapping.data;
+	save->mappingSize = st.Text->mapping.size;
+	save->finalNewline = st.Text->finalNewline;
+	save->worker = std::thread(runFileSave, save);
+	st.pendingSave = save;
+	st.isDirty = false;
+	checkpointRecoveryLog(st);
+	return OK;
+}
+
+static void retireSave(EditorState& st) {
+	FileSave* save = st.pendingSave;
+	save->worker.join();
+	if (save->result != OK) {
+		std::fprintf(stderr, "save failed: %s\n", save->path.c_str());
+		st.isDirty = true;
+	}
+	rebaseRecoveryLog(st, save->result == OK);
+	delete save;
+	st.pendingSave = nullptr;
+}
+
+void pumpFileSave(EditorState& st) {
+	FileSave* save = st.pendingSave;
+	if (!save || !save->finished.load(std::memory_order_acquire)) return;
+	retireSave(st);
+}
+
+void finishFileSave(EditorState& st) {
+	if (!st.pendingSave) return;
+	retireSave(st);
+}
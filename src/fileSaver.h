@@ -0,0 +1,35 @@
+#pragma once
+
+#include <atomic>
+#include <string>
+#include <thread>
+
+#include "config.h"
+#include "textSnapshot.h"
+
+// A save in flight: its thread writes the snapshot to the temp file, fsyncs
+// it, renames it over the target and fsyncs the directory, so the UI never
+// waits on the disk.
+struct FileSave {
+	std::thread worker;
+	std::atomic<bool> finished{false};
+	s32 result = OK;
+
+	int fd = -1;
+	std::string tempPath;
+	std::string path;
+	TextSnapshot snapshot;
+	const char* mappingData = nullptr;
+	u64 mappingSize = 0;
+	bool finalNewline = false;
+};
+
+// Opens a temp file next to `path` and hands it, with a snapshot of
+// st.Text, to a FileSave. Lines still borrowed from the mapping are written
+// from it directly.
+s32 saveFile(EditorState& st, const std::string& path);
+
+void pumpFileSave(EditorState& st);
+
+// Blocks until the pending save, if any, is on disk.
+void finishFileSave(EditorState& st);
@@ -0,0 +1,65 @@
+#include "glyphCache.h"
+
+#include <algorithm>
+
+#include "font.h"
+
+// Atlases carry coverage in alpha, or, when alpha is flat across the whole
+// image, in the color channels.
+static bool hasAlphaCoverage(const TgaImageRGBA& atlas) {
+	size_t count = (size_t)atlas.width * atlas.height;
+	for (size_t i = 1; i < count; i++) {
+		if ((atlas.pixels[i] >> 24) != (atlas.pixels[0] >> 24)) return true;
+	}
+	return false;
+}
+
+static u8 coverageOf(u32 texel, bool alphaCoverage) {
+	if (alphaCoverage) return (u8)(texel >> 24);
+	return (u8)std::max(std::max(texel & 0xFF, (texel >> 8) & 0xFF), (texel >> 16) & 0xFF);
+}
+
+static u32 scaleChannel(u32 color, u32 shift, u32 coverage) {
+	u32 c = ((color >> shift) & 0xFF) * coverage + 128;
+	return ((c + (c >> 8)) >> 8) << shift;
+}
+
+void buildGlyphCache(GlyphCache& cache, Font& font, const TgaImageRGBA& atlas) {
+	cache.coverage.clear();
+	cache.tints.clear();
+
+	bool alphaCoverage = hasAlphaCoverage(atlas);
+	for (u32 c = 0; c < 128; c++) {
+		const Glyph* g = font.getGlyph((char)c);
+		GlyphMask& mask = cache.glyphs[c];
+		mask.xOffset = g->xOffset;
+		mask.yOffset = g->yOffset;
+		mask.xAdvance = g->xAdvance;
+		mask.offset = (u32)cache.coverage.size();
+
+		// Glyphs reaching outside the atlas are cut to what is there.
+		mask.w = (u16)std::min<u32>(g->w, g->x < atlas.width ? atlas.width - g->x : 0);
+		mask.h = (u16)std::min<u32>(g->h, g->y < atlas.height ? atlas.height - g->y : 0);
+
+		for (u32 y = 0; y < mask.h; y++) {
+			const u32* row = atlas.pixels + (g->y + y) * atlas.width + g->x;
+			for (u32 x = 0; x < mask.w; x++) cache.coverage.push_back(coverageOf(row[x], alphaCoverage));
+		}
+	}
+}
+
+const GlyphTint& getGlyphTint(GlyphCache& cache, u32 color) {
+	for (const GlyphTint& tint : cache.tints) {
+		if (tint.color == color) return tint;
+	}
+
+	GlyphTint& tint = cache.tints.emplace_back();
+	tint.color = color;
+	tint.pixels.resize(cache.coverage.size());
+	for (size_t i = 0; i < cache.coverage.size(); i++) {
+		u32 a = cache.coverage[i];
+		tint.pixels[i] = scaleChannel(color, 0, a) | scaleChannel(color, 8, a)
+		               | scaleChannel(color, 16, a) | scaleChannel(color, 24, a);
+	}
+	return tint;
+}
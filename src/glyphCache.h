@@ -0,0 +1,53 @@
+#pragma once
+#include <deque>
+#include <vector>
+
+#include "commonTypes.h"
+#include "diagnostics.h"
+
+struct Font;
+struct TgaImageRGBA;
+
+// Per-glyph 8-bit coverage, cut out of the RGBA atlas once at startup and
+// packed row by row with no padding.
+struct GlyphMask {
+	u16 w = 0, h = 0;
+	s16 xOffset = 0, yOffset = 0;
+	u16 xAdvance = 0;
+	u32 offset = 0;
+};
+
+// The whole glyph set pre-multiplied by one text color, laid out like
+// GlyphCache::coverage, so a blit never touches the atlas or the color.
+struct GlyphTint {
+	u32 color = 0;
+	std::vector<u32> pixels;
+};
+
+struct GlyphCache {
+	GlyphMask glyphs[128]{};
+	std::vector<u8> coverage;
+	std::deque<GlyphTint> tints;
+
+	const GlyphMask* getGlyph(char c) const {
+		DIAG_ASSERT(0 <= c && c <= 127, "GlyphCache::getGlyph character out of range");
+		return &glyphs[(u8)c];
+	}
+};
+
+void buildGlyphCache(GlyphCache& cache, Font& font, const TgaImageRGBA& atlas);
+
+// Creates the tint on first use. Only the UI thread may add colors; once a
+// color exists, looking it up from any thread is read-only.
+const GlyphTint& getGlyphTint(GlyphCache& cache, u32 color);
+
+// dst = color * a + dst * (1 - a) per channel, with `tinted` already holding
+// color * a. Exact for a = 0 and a = 255, no branches.
+inline u32 blendTinted(u32 dst, u32 tinted, u8 coverage) {
+	u32 inv = 255u - coverage;
+	u32 rb = (dst & 0x00FF00FFu) * inv + 0x00800080u;
+	rb = ((rb + ((rb >> 8) & 0x00FF00FFu)) >> 8) & 0x00FF00FFu;
+	u32 ag = ((dst >> 8) & 0x00FF00FFu) * inv + 0x00800080u;
+	ag = (ag + ((ag >> 8) & 0x00FF00FFu)) & 0xFF00FF00u;
+	return tinted + (rb | ag);
+}
@@ -0,0 +1,176 @@
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+
+#include "inputTrace.h"
+
+constexpr u32 TRACE_VERSION = 1;
+
+struct TraceHeader {
+	char magic[4];
+	u32 version;
+};
+
+static void putVarint(std::vector<char>& out, u32 value) {
+	while (value >= 0x80) {
+		out.push_back((char)(value | 0x80));
+		value >>= 7;
+	}
+	out.push_back((char)value);
+}
+
+static bool getVarint(const char*& p, const char* end, u32& value) {
+	value = 0;
+	for (u32 shift = 0; shift < 35; shift += 7) {
+		if (p == end) return false;
+		u8 byte = (u8)*p++;
+		value |= (u32)(byte & 0x7F) << shift;
+		if (!(byte & 0x80)) return true;
+	}
+	return false;
+}
+
+static bool getByte(const char*& p, const char* end, u8& value) {
+	if (p == end) return false;
+	value = (u8)*p++;
+	return true;
+}
+
+s16 startInputRecording(EditorState& st, const std::string& path) {
+	FILE* file = std::fopen(path.c_str(), "wb");
+	if (!file) return ERR_IO;
+
+	TraceHeader header{};
+	std::memcpy(header.magic, "CEIT", 4);
+	header.version = TRACE_VERSION;
+	if (std::fwrite(&header, sizeof(header), 1, file) != 1) {
+		std::fclose(file);
+		return ERR_IO;
+	}
+
+	st.inputRecorder = new InputRecorder{};
+	st.inputRecorder->file = file;
+	return OK;
+}
+
+void recordInputEvent(EditorState& st, const SDL_Event& e) {
+	InputRecorder* rec = st.inputRecorder;
+	if (!rec) return;
+
+	std::vector<char>& out = rec->record;
+	out.clear();
+	u32 timestamp;
+	if (e.type == SDL_KEYDOWN) {
+		timestamp = e.key.timestamp;
+		out.push_back((char)TraceKeyDown);
+	} else if (e.type == SDL_TEXTINPUT) {
+		timestamp = e.text.timestamp;
+		out.push_back((char)TraceTextInput);
+	} else if (e.type == SDL_MOUSEBUTTONDOWN) {
+		timestamp = e.button.timestamp;
+		out.push_back((char)TraceMouseDown);
+	} else if (e.type == SDL_WINDOWEVENT && e.window.event == SDL_WINDOWEVENT_EXPOSED) {
+		timestamp = e.window.timestamp;
+		out.push_back((char)TraceExposed);
+	} else {
+		return;
+	}
+
+	putVarint(out, rec->empty || timestamp < rec->lastTimestamp ? 0 : timestamp - rec->lastTimestamp);
+	rec->lastTimestamp = timestamp;
+	rec->empty = false;
+
+	switch ((TraceEventType)out[0]) {
+		case TraceKeyDown: {
+			putVarint(out, (u32)e.key.keysym.sym);
+			putVarint(out, (u32)e.key.keysym.mod);
+			out.push_back((char)e.key.repeat);
+		} break;
+		case TraceTextInput: {
+			u32 len = (u32)strnlen(e.text.text, sizeof(e.text.text));
+			putVarint(out, len);
+			out.insert(out.end(), e.text.text, e.text.text + len);
+		} break;
+		case TraceMouseDown: {
+			out.push_back((char)e.button.button);
+			putVarint(out, (u32)std::max(e.button.x, 0));
+			putVarint(out, (u32)std::max(e.button.y, 0));
+		} break;
+		case TraceExposed: break;
+	}
+	std::fwrite(out.data(), 1, out.size(), rec->file);
+}
+
+void stopInputRecording(EditorState& st) {
+	InputRecorder* rec = st.inputRecorder;
+	if (!rec) return;
+	std::fclose(rec->file);
+	delete rec;
+	st.inputRecorder = nullptr;
+}
+
+s16 readInputTrace(const std::string& path, std::vector<SDL_Event>& events) {
+	std::ifstream file(path, std::ios::binary);
+	if (!file) return ERR_FILE_NOT_FOUND;
+	std::vector<char> data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+	TraceHeader header{};
+	if (data.size() < sizeof(header)) return ERR_UNSUPPORTED;
+	std::memcpy(&header, data.data(), sizeof(header));
+	if (std::memcmp(header.magic, "CEIT", 4) != 0 || header.version != TRACE_VERSION) return ERR_UNSUPPORTED;
+
+	const char* p = data.data() + sizeof(header);
+	const char* end = data.data() + data.size();
+	u32 timestamp = 0;
+	while (p != end) {
+		u8 type;
+		u32 delta;
+		if (!getByte(p, end, type) || !getVarint(p, end, delta)) return ERR_EOF;
+		timestamp += delta;
+
+		SDL_Event e;
+		std::memset(&e, 0, sizeof(e));
+		switch ((TraceEventType)type) {
+			case TraceKeyDown: {
+				u32 sym, mod;
+				u8 repeat;
+				if (!getVarint(p, end, sym) || !getVarint(p, end, mod) || !getByte(p, end, repeat)) return ERR_EOF;
+				e.type = SDL_KEYDOWN;
+				e.key.timestamp = timestamp;
+				e.key.state = SDL_PRESSED;
+				e.key.repeat = repeat;
+				e.key.keysym.sym = (SDL_Keycode)sym;
+				e.key.keysym.mod = (u16)mod;
+			} break;
+			case TraceTextInput: {
+				u32 len;
+				if (!getVarint(p, end, len) || len >= sizeof(e.text.text) || (size_t)(end - p) < len) return ERR_EOF;
+				e.type = SDL_TEXTINPUT;
+				e.text.timestamp = timestamp;
+				std::memcpy(e.text.text, p, len);
+				p += len;
+			} break;
+			case TraceMouseDown: {
+				u8 button;
+				u32 x, y;
+				if (!getByte(p, end, button) || !getVarint(p, end, x) || !getVarint(p, end, y)) return ERR_EOF;
+				e.type = SDL_MOUSEBUTTONDOWN;
+				e.button.timestamp = timestamp;
+				e.button.button = button;
+				e.button.state = SDL_PRESSED;
+				e.button.clicks = 1;
+				e.button.x = (s32)x;
+				e.button.y = (s32)y;
+			} break;
+			case TraceExposed: {
+				e.type = SDL_WINDOWEVENT;
+				e.window.timestamp = timestamp;
+				e.window.event = SDL_WINDOWEVENT_EXPOSED;
+			} break;
+			default: return ERR_UNSUPPORTED;
+		}
+		events.push_back(e);
+	}
+	return OK;
+}
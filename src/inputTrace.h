@@ -0,0 +1,38 @@
+#pragma once
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include <SDL.h>
+
+#include "config.h"
+
+enum TraceEventType : u8 {
+	TraceKeyDown = 1, TraceTextInput = 2, TraceMouseDown = 3, TraceExposed = 4
+};
+
+// Binary trace of the events main hands to handleEditorEvent. After the
+// header each event is a TraceEventType byte and the milliseconds since the
+// one before as a varint, then
+//   TraceKeyDown    keycode and modifiers as varints, a repeat byte
+//   TraceTextInput  length as a varint, then the UTF-8 bytes
+//   TraceMouseDown  button byte, x and y as varints
+//   TraceExposed    nothing
+// Resizes are not recorded; a replay runs at one window size.
+struct InputRecorder {
+	FILE* file = nullptr;
+	u32 lastTimestamp = 0;
+	bool empty = true;
+	std::vector<char> record;
+};
+
+s16 startInputRecording(EditorState& st, const std::string& path);
+
+// Appends e when recording and e is one of the recorded kinds.
+void recordInputEvent(EditorState& st, const SDL_Event& e);
+
+void stopInputRecording(EditorState& st);
+
+// Decodes a whole trace back into events; timestamps are milliseconds since
+// the first one.
+s16 readInputTrace(const std::string& path, std::vector<SDL_Event>& events);
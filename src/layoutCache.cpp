@@ -0,0 +1,45 @@
+#include "layoutCache.h"
+#include "config.h"
+
+#include <algorithm>
+
+static void layoutSpan(std::string_view text, const GlyphCache& glyphs, u32 spaceAdvance, std::vector<u32>& x, u32& pos) {
+	for (char c : text) {
+		x.push_back(pos);
+		pos += c == '\t' ? spaceAdvance * TAB_SIZE : glyphs.getGlyph(c)->xAdvance;
+	}
+}
+
+const LineLayout& getLineLayout(LayoutCache& cache, const GlyphCache& glyphs, const LineBuffer* lb) {
+	LineLayout& layout = cache.lines[lb];
+	if (layout.version == lb->version) return layout;
+
+	u32 spaceAdvance = glyphs.getGlyph(' ')->xAdvance;
+	u32 pos = 0;
+	layout.x.clear();
+	layout.x.reserve((size_t)lb->size + 1);
+	layoutSpan(lb->head(), glyphs, spaceAdvance, layout.x, pos);
+	layoutSpan(lb->tail(), glyphs, spaceAdvance, layout.x, pos);
+	layout.x.push_back(pos);
+	layout.version = lb->version;
+	return layout;
+}
+
+void trimLayoutCache(LayoutCache& cache, u32 visibleLines) {
+	if (cache.lines.size() > (size_t)visibleLines * 8 + 256) cache.lines.clear();
+}
+
+void clearLayoutCache(LayoutCache& cache) {
+	cache.lines.clear();
+}
+
+u32 columnAtX(const LineLayout& layout, u32 x) {
+	auto it = std::upper_bound(layout.x.begin(), layout.x.end(), x);
+	if (it == layout.x.end()) return (u32)layout.x.size() - 1;
+	return it == layout.x.begin() ? 0 : (u32)(it - layout.x.begin()) - 1;
+}
+
+u32 firstVisibleColumn(const LineLayout& layout, u32 x) {
+	auto it = std::upper_bound(layout.x.begin() + 1, layout.x.end(), x);
+	return (u32)(it - layout.x.begin()) - 1;
+}
@@ -0,0 +1,35 @@
+#pragma once
+#include <unordered_map>
+#include <vector>
+
+#include "commonTypes.h"
+#include "glyphCache.h"
+#include "textBuffer.h"
+
+// x[i] is where column i starts, relative to the start of the line, with
+// tabs expanded; x[size] is the width of the whole line. Valid while the
+// line still has the version it was built from.
+struct LineLayout {
+	u64 version = 0;
+	std::vector<u32> x;
+};
+
+struct LayoutCache {
+	std::unordered_map<const LineBuffer*, LineLayout> lines;
+};
+
+// Lays the line out again only if it was edited since the last call.
+// Inserts into the cache, so only the UI thread may call it; references
+// stay valid until the next trimLayoutCache or clearLayoutCache.
+const LineLayout& getLineLayout(LayoutCache& cache, const GlyphCache& glyphs, const LineBuffer* lb);
+
+// Drops everything once the cache has grown well past what a screen needs.
+void trimLayoutCache(LayoutCache& cache, u32 visibleLines);
+
+void clearLayoutCache(LayoutCache& cache);
+
+// Column whose glyph covers x, or the line size when x is past the end.
+u32 columnAtX(const LineLayout& layout, u32 x);
+
+// First column that ends after x, for drawing a line scrolled by x pixels.
+u32 firstVisibleColumn(const LineLayout& layout, u32 x);
@@ -0,0 +1,135 @@
+#include "lineIndex.h"
+#include "cpuFeatures.h"
+#include "diagnostics.h"
+
+#include <cstring>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#include <immintrin.h>
+#define LINE_INDEX_X86 1
+#elif defined(__aarch64__)
+#include <arm_neon.h>
+#define LINE_INDEX_NEON 1
+#endif
+
+static void emitBits(u64 bits, u64 offset, std::vector<u64>& newlines) {
+	while (bits) {
+		newlines.push_back(offset + (u64)__builtin_ctzll(bits));
+		bits &= bits - 1;
+	}
+}
+
+static void scanScalar(const char* data, size_t size, u64 base, std::vector<u64>& newlines) {
+	const char* curr = data;
+	const char* end = data + size;
+	while (curr < end) {
+		const char* newline = (const char*)std::memchr(curr, '\n', (size_t)(end - curr));
+		if (!newline) break;
+		newlines.push_back(base + (u64)(newline - data));
+		curr = newline + 1;
+	}
+}
+
+#if defined(LINE_INDEX_X86)
+static void scanSSE2(const char* data, size_t size, u64 base, std::vector<u64>& newlines) {
+	const __m128i needle = _mm_set1_epi8('\n');
+	size_t i = 0;
+	for (; i + 64 <= size; i += 64) {
+		const __m128i* block = (const __m128i*)(data + i);
+		u64 m0 = (u32)_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128(block + 0), needle));
+		u64 m1 = (u32)_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128(block + 1), needle));
+		u64 m2 = (u32)_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128(block + 2), needle));
+		u64 m3 = (u32)_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128(block + 3), needle));
+		emitBits(m0 | (m1 << 16) | (m2 << 32) | (m3 << 48), base + i, newlines);
+	}
+	scanScalar(data + i, size - i, base + i, newlines);
+}
+
+__attribute__((target("avx2")))
+static void scanAVX2(const char* data, size_t size, u64 base, std::vector<u64>& newlines) {
+	const __m256i needle = _mm256_set1_epi8('\n');
+	size_t i = 0;
+	for (; i + 64 <= size; i += 64) {
+		const __m256i* block = (const __m256i*)(data + i);
+		u64 lo = (u32)_mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_loadu_si256(block + 0), needle));
+		u64 hi = (u32)_mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_loadu_si256(block + 1), needle));
+		emitBits(lo | (hi << 32), base + i, newlines);
+	}
+	scanScalar(data + i, size - i, base + i, newlines);
+}
+#endif
+
+#if defined(LINE_INDEX_NEON)
+static u64 neonBitmask(uint8x16_t c0, uint8x16_t c1, uint8x16_t c2, uint8x16_t c3) {
+	const uint8x16_t bits = { 0x01, 0x02, 0x04, 0x08, 0x10, 0x20, 0x40, 0x80,
+	                          0x01, 0x02, 0x04, 0x08, 0x10, 0x20, 0x40, 0x80 };
+	uint8x16_t sum0 = vpaddq_u8(vandq_u8(c0, bits), vandq_u8(c1, bits));
+	uint8x16_t sum1 = vpaddq_u8(vandq_u8(c2, bits), vandq_u8(c3, bits));
+	sum0 = vpaddq_u8(sum0, sum1);
+	sum0 = vpaddq_u8(sum0, sum0);
+	return vgetq_lane_u64(vreinterpretq_u64_u8(sum0), 0);
+}
+
+static void scanNEON(const char* data, size_t size, u64 base, std::vector<u64>& newlines) {
+	const uint8x16_t needle = vdupq_n_u8('\n');
+	size_t i = 0;
+	for (; i + 64 <= size; i += 64) {
+		const u8* block = (const u8*)(data + i);
+		uint8x16_t c0 = vceqq_u8(vld1q_u8(block + 0), needle);
+		uint8x16_t c1 = vceqq_u8(vld1q_u8(block + 16), needle);
+		uint8x16_t c2 = vceqq_u8(vld1q_u8(block + 32), needle);
+		uint8x16_t c3 = vceqq_u8(vld1q_u8(block + 48), needle);
+		emitBits(neonBitmask(c0, c1, c2, c3), base + i, newlines);
+	}
+	scanScalar(data + i, size - i, base + i, newlines);
+}
+#endif
+
+bool isNewlineScanKernelSupported(NewlineScanKernel kernel) {
+	const CpuFeatures& cpu = getCpuFeatures();
+	switch (kernel) {
+		case ScanScalar: return true;
+		case ScanSSE2: return cpu.sse2;
+		case ScanAVX2: return cpu.avx2;
+		case ScanNEON: return cpu.neon;
+	}
+	return false;
+}
+
+NewlineScanKernel bestNewlineScanKernel() {
+	static const NewlineScanKernel best = []() {
+		if (isNewlineScanKernelSupported(ScanAVX2)) return ScanAVX2;
+		if (isNewlineScanKernelSupported(ScanNEON)) return ScanNEON;
+		if (isNewlineScanKernelSupported(ScanSSE2)) return ScanSSE2;
+		return ScanScalar;
+	}();
+	return best;
+}
+
+const char* newlineScanKernelName(NewlineScanKernel kernel) {
+	switch (kernel) {
+		case ScanScalar: return "scalar";
+		case ScanSSE2: return "sse2";
+		case ScanAVX2: return "avx2";
+		case ScanNEON: return "neon";
+	}
+	return "unknown";
+}
+
+void indexNewlines(const char* data, size_t size, u64 base, std::vector<u64>& newlines, NewlineScanKernel kernel) {
+	DIAG_ASSERT(isNewlineScanKernelSupported(kernel), "indexNewlines kernel not supported");
+	switch (kernel) {
+#if defined(LINE_INDEX_X86)
+		case ScanSSE2: scanSSE2(data, size, base, newlines); return;
+		case ScanAVX2: scanAVX2(data, size, base, newlines); return;
+#endif
+#if defined(LINE_INDEX_NEON)
+		case ScanNEON: scanNEON(data, size, base, newlines); return;
+#endif
+		default: scanScalar(data, size, base, newlines); return;
+	}
+}
+
+void indexNewlines(const char* data, size_t size, u64 base, std::vector<u64>& newlines) {
+	indexNewlines(data, size, base, newlines, bestNewlineScanKernel());
+}
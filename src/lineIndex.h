@@ -0,0 +1,23 @@
+#pragma once
+#include <cstddef>
+#include <vector>
+
+#include "commonTypes.h"
+
+enum NewlineScanKernel {
+	ScanScalar = 0, ScanSSE2 = 1, ScanAVX2 = 2, ScanNEON = 3
+};
+
+NewlineScanKernel bestNewlineScanKernel();
+
+bool isNewlineScanKernelSupported(NewlineScanKernel kernel);
+
+const char* newlineScanKernelName(NewlineScanKernel kernel);
+
+// Appends base + offset of every '\n' in [data, data + size) to newlines.
+// The scan is split into 64-byte blocks; each block yields one bitmask of
+// newline positions, so the per-line cost is a ctz instead of a compare
+// per byte. Chunked callers pass the chunk's file offset as base.
+void indexNewlines(const char* data, size_t size, u64 base, std::vector<u64>& newlines);
+
+void indexNewlines(const char* data, size_t size, u64 base, std::vector<u64>& newlines, NewlineScanKernel kernel);
@@ -1,23 +1,61 @@
 #include <cassert>
 #include <print>
 #include <string>
+#include <thread>
 #include <cstring>
+#include <vector>
 
 #include <SDL.h>
 
 #include "eventHandlers.h"
 #include "render.h"
 #include "fileLoader.h"
+#include "fileSaver.h"
+#include "recoveryLog.h"
+#include "rasterPool.h"
+#include "inputTrace.h"
+#include "profiler.h"
 
-f64 getDeltaTimeSeconds() {
-	static u64 last = 0;
+f64 getElapsedSeconds(u64 since) {
 	u64 now = SDL_GetPerformanceCounter();
-	f64 dt = last ? (double)(now - last) / (double)SDL_GetPerformanceFrequency() : 0.0;
-	last = now;
-	return dt;
+	return (f64)(now - since) / (f64)SDL_GetPerformanceFrequency();
+}
+
+// Milliseconds until the next frame is due, or -1 while nothing needs to be
+// drawn. Edits and cursor moves are drawn as soon as FRAME_CAP_FPS allows; a
+// streaming load or a save being flushed only ticks the status label every
+// LOAD_TICK_MS.
+static s32 msUntilNextFrame(EditorState& st, u64 lastFrameStart) {
+	f64 interval;
+	if (hasDamage(st)) interval = FRAME_CAP_FPS ? 1.0 / FRAME_CAP_FPS : 0.0;
+	else if (st.pendingLoad || st.pendingSave) interval = LOAD_TICK_MS / 1000.0;
+	else return -1;
+
+	f64 remaining = interval - getElapsedSeconds(lastFrameStart);
+	return remaining > 0.0 ? (s32)(remaining * 1000.0) + 1 : 0;
+}
+
+static bool handleEvent(EditorState& st, SDL_Event& e, SDL_Renderer* renderer, SDL_Texture*& texture) {
+	if (e.type == SDL_QUIT) return false;
+
+	if (e.type == SDL_WINDOWEVENT && e.window.event == SDL_WINDOWEVENT_SIZE_CHANGED) {
+		SDL_DestroyTexture(texture);
+		texture = resizeWindow(st, (u32)e.window.data1, (u32)e.window.data2, renderer);
+
+		st.MaxDisplayedLineCount = (st.screenBuf.height - TPAD - BPAD) / LINE_HEIGHT;
+		st.DisplayedLineCount = std::min(st.Text->size, st.MaxDisplayedLineCount);
+		st.BottomLine = st.TopLine + st.DisplayedLineCount - 1;
+		if (st.BottomLine >= st.Text->size) st.BottomLine = st.Text->size - 1;
+		markAllDirty(st);
+	}
+
+	recordInputEvent(st, e);
+	handleEditorEvent(st, e);
+	return true;
 }
 
 s32 main() {
+	TRACE_THREAD_NAME("main");
 	if (SDL_Init(SDL_INIT_VIDEO | SDL_INIT_TIMER) != 0) {
 		std::println("SDL_Init failed.");
 		return ERR_UNKNOWN;
@@ -34,7 +72,7 @@ s32 main() {
 		return ERR_UNKNOWN;
 	}
 
-	SDL_Renderer* renderer = SDL_CreateRenderer(window, -1, 0);
+	SDL_Renderer* renderer = SDL_CreateRenderer(window, -1, VSYNC_ENABLED ? SDL_RENDERER_PRESENTVSYNC : 0);
 	if (!renderer) {
 		std::println("SDL_CreateRenderer failed.");
 		return ERR_UNKNOWN;
@@ -50,14 +88,17 @@ s32 main() {
 	}
 
 	EditorState st{};
-	st.screenBuf = { WINDOW_WIDTH, WINDOW_HEIGHT, 4 * WINDOW_WIDTH,
-					 (u32*)SDL_malloc((size_t)WINDOW_WIDTH * (size_t)WINDOW_HEIGHT * 4) };
+	resizeOffscreenBuffer(st.screenBuf, WINDOW_WIDTH, WINDOW_HEIGHT);
 
-	if (loadFile(st, FILE_PATH) != 0) {
+	if (beginLoadFile(st, FILE_PATH) != 0) {
 		std::println("loadFile failed.");
 		return ERR_FILE_NOT_FOUND;
 	};
 	st.MaxDisplayedLineCount = (st.screenBuf.height - TPAD - BPAD) / LINE_HEIGHT;
+	waitForLoadedLines(st, st.MaxDisplayedLineCount);
+	s32 recovered = startRecoveryLog(st);
+	if (recovered > 0) std::println("Recovered {} unsaved edits.", recovered);
+	else if (recovered < 0) std::println("Could not open the recovery log.");
 	st.DisplayedLineCount = std::min(st.Text->size, st.MaxDisplayedLineCount);
 	st.BottomLine = st.DisplayedLineCount - 1;
 	st.CurrLineBuffer = st.Text->getLineBuffer(st.CurrLine);
@@ -72,57 +113,86 @@ s32 main() {
 		std::println("loadTga failed.");
 		return tgaResult;
 	}
+	buildGlyphCache(st.Glyphs, st.Font, st.TgaFontImg);
 
+	u32 rasterWorkers = RASTER_THREADS ? RASTER_THREADS - 1 : std::max(std::thread::hardware_concurrency(), 1u) - 1;
+	st.rasterPool = startRasterPool(rasterWorkers);
+	startHighlightWorker(st.Syntax);
+	if (RECORD_INPUT_TRACE && startInputRecording(st, INPUT_TRACE_PATH) != OK) {
+		std::println("Could not open the input trace.");
+	}
+
+	std::vector<DirtyRect> dirtyRects;
+	u64 lastFrameStart = 0;
+	f32 frameMs = 0.0f;
 	bool running = true;
 	while (running) {
-		double dt = getDeltaTimeSeconds();
-		double fps = (dt > 0.0) ? (1.0 / dt) : 0.0;
-
+		// Sleep in SDL until input arrives or a frame is due instead of spinning.
+		s32 untilFrame = msUntilNextFrame(st, lastFrameStart);
 		SDL_Event e;
-		while (SDL_PollEvent(&e)) {
-			if (e.type == SDL_QUIT) running = false;
-
-			if (e.type == SDL_WINDOWEVENT && e.window.event == SDL_WINDOWEVENT_SIZE_CHANGED) {
-				SDL_DestroyTexture(texture);
-				texture = resizeWindow(st, (u32)e.window.data1, (u32)e.window.data2, renderer);
-
-				st.MaxDisplayedLineCount = (st.screenBuf.height - TPAD - BPAD) / LINE_HEIGHT;
-				st.DisplayedLineCount = std::min(st.Text->size, st.MaxDisplayedLineCount);
-				st.BottomLine = st.TopLine + st.DisplayedLineCount - 1;
-				if (st.BottomLine >= st.Text->size) st.BottomLine = st.Text->size - 1;
-			}
-
-			if (st.CurrMode == InsertMode) {
-        			if (e.type == SDL_TEXTINPUT) {
-        				handleInsertModeTextInput(st, e);
-        			} else if (e.type == SDL_KEYDOWN) {
-        				handleInsertModeKeyDown(st, e);
-        			}
-			}
-			else {
-				if (e.type == SDL_KEYDOWN) {
-					if (st.CurrMode == NormalMode) handleNormalModeEvent(st, e);
-					else if (st.CurrMode == VisualMode) handleVisualModeEvent(st, e);
-				}
+		s32 wait = untilFrame < 0 ? (s32)IDLE_WAIT_MS : untilFrame;
+		if (searchPending(st)) wait = std::min(wait, (s32)SEARCH_TICK_MS);
+		else if (highlightPending(st)) wait = std::min(wait, (s32)HIGHLIGHT_TICK_MS);
+		if (SDL_WaitEventTimeout(&e, wait)) {
+			PROFILE_SCOPE(ProfileEvents);
+			running = handleEvent(st, e, renderer, texture);
+			while (running && SDL_PollEvent(&e)) running = handleEvent(st, e, renderer, texture);
+		}
+		if (!running) break;
+
+		{
+			PROFILE_SCOPE(ProfilePump);
+			pumpFileLoad(st);
+			pumpFileSave(st);
+			pumpSearch(st);
+			pumpHighlight(st);
+			flushRecoveryLog(st);
+		}
+		pumpTraceToggle();
+		if (msUntilNextFrame(st, lastFrameStart) != 0) continue;
+
+		u64 frameStart = SDL_GetPerformanceCounter();
+		lastFrameStart = frameStart;
+
+		beginFrame(st);
+		renderTextRows(st);
+		renderBottom(st, frameMs);
+		renderProfilerOverlay(st);
+
+		collectDirtyRects(st, dirtyRects);
+		{
+			PROFILE_SCOPE(ProfileUpload);
+			for (const DirtyRect& r : dirtyRects) {
+				SDL_Rect rect{ 0, (int)r.y, (int)st.screenBuf.width, (int)r.h };
+				SDL_UpdateTexture(texture, &rect, st.screenBuf.row(r.y), (int)st.screenBuf.pitch);
 			}
 		}
+		endFrame(st);
 
-		renderSelectedLine(st);
-		renderLineSeparators(st);
-		renderLineNumbers(st);
-		renderSelectedPosition(st, GRAY_70);
-		renderTextBuffer(st);
-		renderBottom(st, (u32)fps);
-
-		SDL_UpdateTexture(texture, nullptr, st.screenBuf.pixels, (int)st.screenBuf.pitch);
-		std::memset(st.screenBuf.pixels, 0, (size_t)st.screenBuf.pitch * (size_t)st.screenBuf.height);
+		{
+			PROFILE_SCOPE(ProfileCopy);
+			SDL_RenderClear(renderer);
+			SDL_RenderCopy(renderer, texture, nullptr, nullptr);
+		}
 
-		SDL_RenderClear(renderer);
-		SDL_RenderCopy(renderer, texture, nullptr, nullptr);
-		SDL_RenderPresent(renderer);
+		// Present is left out so a vsync wait does not count as frame cost;
+		// the label shows the previous frame's cost.
+		frameMs = (f32)(getElapsedSeconds(frameStart) * 1000.0);
+		{
+			PROFILE_SCOPE(ProfilePresent);
+			SDL_RenderPresent(renderer);
+		}
+		endProfileFrame();
 	}
 
-	SDL_free(st.screenBuf.pixels);
+	cancelFileLoad(st);
+	finishFileSave(st);
+	closeRecoveryLog(st);
+	stopInputRecording(st);
+	stopTrace();
+	stopRasterPool(st.rasterPool);
+	stopHighlightWorker(st.Syntax);
+	freeOffscreenBuffer(st.screenBuf);
 	SDL_DestroyTexture(texture);
 	SDL_DestroyRenderer(renderer);
 	SDL_DestroyWindow(window);
@@ -0,0 +1,40 @@
+#include "mappedFile.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+s16 mapFile(MappedFile& file, const std::string& path) {
+	int fd = open(path.c_str(), O_RDONLY);
+	if (fd < 0) return ERR_FILE_NOT_FOUND;
+
+	struct stat info{};
+	if (fstat(fd, &info) != 0) {
+		close(fd);
+		return ERR_UNKNOWN;
+	}
+
+	file.data = nullptr;
+	file.size = (size_t)info.st_size;
+	if (file.size == 0) {
+		close(fd);
+		return OK;
+	}
+
+	void* data = mmap(nullptr, file.size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (data == MAP_FAILED) {
+		file.size = 0;
+		return ERR_UNKNOWN;
+	}
+
+	file.data = (const char*)data;
+	return OK;
+}
+
+void unmapFile(MappedFile& file) {
+	if (file.data) munmap((void*)file.data, file.size);
+	file.data = nullptr;
+	file.size = 0;
+}
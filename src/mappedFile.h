@@ -0,0 +1,16 @@
+#pragma once
+#include <cstddef>
+#include <string>
+
+#include "commonTypes.h"
+
+// Read-only, private mapping of a whole file. Lines borrowed from it stay
+// valid until unmapFile; truncating the file underneath it is not supported.
+struct MappedFile {
+	const char* data = nullptr;
+	size_t size = 0;
+};
+
+s16 mapFile(MappedFile& file, const std::string& path);
+
+void unmapFile(MappedFile& file);
@@ -0,0 +1,65 @@
+#include "profiler.h"
+#include "config.h"
+
+const char* const PROFILE_PHASE_NAMES[ProfilePhaseCount] = {
+	"events", "pump", "beginFrame", "clear", "renderTextRows", "renderBottom",
+	"dirtyRects", "upload", "endFrame", "copy", "present"
+};
+
+#if PROFILING
+#include <atomic>
+
+// Single writer ring: the UI thread fills slot written % PROFILE_FRAMES and
+// then bumps `written`. A reader copies a slot and drops it if `written` has
+// since lapped it, so neither side ever waits.
+struct ProfileSlot {
+	std::atomic<u64> ticks[ProfilePhaseCount];
+};
+
+static ProfileSlot g_frames[PROFILE_FRAMES];
+static std::atomic<u64> g_written{0};
+static FrameProfile g_current{};
+static bool g_overlay = false;
+
+void addProfileTicks(ProfilePhase phase, u64 ticks) {
+	g_current.ticks[phase] += ticks;
+}
+
+void endProfileFrame() {
+	u64 written = g_written.load(std::memory_order_relaxed);
+	ProfileSlot& slot = g_frames[written % PROFILE_FRAMES];
+	// Pairs with the fence in copyProfileFrames: a reader that sees any of
+	// the stores below also sees `written` at this frame.
+	std::atomic_thread_fence(std::memory_order_release);
+	for (u32 p = 0; p < ProfilePhaseCount; p++) {
+		slot.ticks[p].store(g_current.ticks[p], std::memory_order_relaxed);
+		g_current.ticks[p] = 0;
+	}
+	g_written.store(written + 1, std::memory_order_release);
+}
+
+u32 copyProfileFrames(FrameProfile* out, u32 max) {
+	u64 written = g_written.load(std::memory_order_acquire);
+	u32 count = 0;
+	for (u64 frame = written; frame > 0 && count < max && written - frame < PROFILE_FRAMES; frame--) {
+		const ProfileSlot& slot = g_frames[(frame - 1) % PROFILE_FRAMES];
+		for (u32 p = 0; p < ProfilePhaseCount; p++) out[count].ticks[p] = slot.ticks[p].load(std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_acquire);
+		// The writer is on the slot of frame `now`; anything that far back has
+		// been overwritten while we read it.
+		u64 now = g_written.load(std::memory_order_relaxed);
+		if (now - (frame - 1) >= PROFILE_FRAMES) break;
+		count++;
+	}
+	return count;
+}
+
+void toggleProfilerOverlay() {
+	g_overlay = !g_overlay;
+}
+
+bool profilerOverlayVisible() {
+	return g_overlay;
+}
+
+#endif
@@ -0,0 +1,69 @@
+#pragma once
+#include "commonTypes.h"
+#include "traceExport.h"
+
+// Built with PROFILING=1, PROFILE_SCOPE times the rest of its scope with
+// SDL_GetPerformanceCounter and adds it to the phase for the frame being
+// drawn. Without it the macro and every function below expand to nothing.
+enum ProfilePhase : u8 {
+	ProfileEvents, ProfilePump, ProfileBeginFrame, ProfileClear, ProfileTextRows, ProfileBottom,
+	ProfileDirtyRects, ProfileUpload, ProfileEndFrame, ProfileCopy, ProfilePresent, ProfilePhaseCount
+};
+
+extern const char* const PROFILE_PHASE_NAMES[ProfilePhaseCount];
+
+// ProfileClear is spent inside ProfileBeginFrame; every other phase is on
+// its own.
+constexpr bool isNestedProfilePhase(ProfilePhase phase) { return phase == ProfileClear; }
+
+// Performance counter ticks spent in each phase for one drawn frame, with
+// the events and pumps of every loop pass since the frame before.
+struct FrameProfile {
+	u64 ticks[ProfilePhaseCount];
+};
+
+#if PROFILING
+
+void addProfileTicks(ProfilePhase phase, u64 ticks);
+
+// Publishes the frame's ticks to the ring of the last PROFILE_FRAMES frames
+// and starts the next one. UI thread only.
+void endProfileFrame();
+
+// Copies up to `max` of the newest frames into out, newest first, and
+// returns how many. Never blocks the UI thread, so it may run on any.
+u32 copyProfileFrames(FrameProfile* out, u32 max);
+
+void toggleProfilerOverlay();
+
+bool profilerOverlayVisible();
+
+// Also a begin/end pair in the trace, when one is running.
+struct ProfileScope {
+	ProfilePhase phase;
+	u64 start;
+	bool traced;
+
+	explicit ProfileScope(ProfilePhase phase) : phase(phase), start(SDL_GetPerformanceCounter()), traced(tracing()) {
+		if (traced) traceEvent(PROFILE_PHASE_NAMES[phase], 'B', start);
+	}
+	~ProfileScope() {
+		u64 end = SDL_GetPerformanceCounter();
+		addProfileTicks(phase, end - start);
+		if (traced) traceEvent(PROFILE_PHASE_NAMES[phase], 'E', end);
+	}
+	ProfileScope(const ProfileScope&) = delete;
+	ProfileScope& operator=(const ProfileScope&) = delete;
+};
+
+#define PROFILE_SCOPE(phase) ProfileScope PROFILE_JOIN(profileScope, __LINE__){ phase }
+
+#else
+
+inline void endProfileFrame() {}
+inline void toggleProfilerOverlay() {}
+inline bool profilerOverlayVisible() { return false; }
+
+#define PROFILE_SCOPE(phase) ((void)0)
+
+#endif
@@ -0,0 +1,216 @@
+#include "rasterKernels.h"
+#include "cpuFeatures.h"
+#include "diagnostics.h"
+#include "glyphCache.h"
+
+#include <algorithm>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#include <immintrin.h>
+#define RASTER_X86 1
+#elif defined(__aarch64__)
+#include <arm_neon.h>
+#define RASTER_NEON 1
+#endif
+
+static void fillSpanScalar(u32* dst, u32 count, u32 color) {
+	std::fill_n(dst, count, color);
+}
+
+static void blendSpanScalar(u32* dst, const u32* tinted, const u8* coverage, u32 count) {
+	for (u32 i = 0; i < count; i++) dst[i] = blendTinted(dst[i], tinted[i], coverage[i]);
+}
+
+#if defined(RASTER_X86)
+static void fillSpanSSE2(u32* dst, u32 count, u32 color) {
+	const __m128i c = _mm_set1_epi32((s32)color);
+	u32 i = 0;
+	for (; i + 16 <= count; i += 16) {
+		_mm_storeu_si128((__m128i*)(dst + i + 0), c);
+		_mm_storeu_si128((__m128i*)(dst + i + 4), c);
+		_mm_storeu_si128((__m128i*)(dst + i + 8), c);
+		_mm_storeu_si128((__m128i*)(dst + i + 12), c);
+	}
+	for (; i + 4 <= count; i += 4) _mm_storeu_si128((__m128i*)(dst + i), c);
+	fillSpanScalar(dst + i, count - i, color);
+}
+
+// Same arithmetic as blendTinted on 16-bit lanes: d * inv + 128, plus its
+// own high byte, shifted down by 8. Sums stay below 65536 and the tinted
+// add never carries between channels, so results match bit for bit.
+static __m128i blend16SSE2(__m128i dst, __m128i inv) {
+	__m128i x = _mm_add_epi16(_mm_mullo_epi16(dst, inv), _mm_set1_epi16(128));
+	return _mm_srli_epi16(_mm_add_epi16(x, _mm_srli_epi16(x, 8)), 8);
+}
+
+static __m128i blend4SSE2(__m128i dst, __m128i tinted, const u8* coverage) {
+	const __m128i zero = _mm_setzero_si128();
+	s32 packed;
+	std::memcpy(&packed, coverage, 4);
+	__m128i a = _mm_cvtsi32_si128(packed);
+	a = _mm_unpacklo_epi8(a, a);
+	a = _mm_unpacklo_epi16(a, a);
+	__m128i inv = _mm_xor_si128(a, _mm_set1_epi8(-1));
+
+	__m128i lo = blend16SSE2(_mm_unpacklo_epi8(dst, zero), _mm_unpacklo_epi8(inv, zero));
+	__m128i hi = blend16SSE2(_mm_unpackhi_epi8(dst, zero), _mm_unpackhi_epi8(inv, zero));
+	return _mm_add_epi8(_mm_packus_epi16(lo, hi), tinted);
+}
+
+static void blendSpanSSE2(u32* dst, const u32* tinted, const u8* coverage, u32 count) {
+	u32 i = 0;
+	for (; i + 4 <= count; i += 4) {
+		__m128i d = _mm_loadu_si128((const __m128i*)(dst + i));
+		__m128i t = _mm_loadu_si128((const __m128i*)(tinted + i));
+		_mm_storeu_si128((__m128i*)(dst + i), blend4SSE2(d, t, coverage + i));
+	}
+	blendSpanScalar(dst + i, tinted + i, coverage + i, count - i);
+}
+
+__attribute__((target("avx2")))
+static void fillSpanAVX2(u32* dst, u32 count, u32 color) {
+	const __m256i c = _mm256_set1_epi32((s32)color);
+	u32 i = 0;
+	for (; i + 32 <= count; i += 32) {
+		_mm256_storeu_si256((__m256i*)(dst + i + 0), c);
+		_mm256_storeu_si256((__m256i*)(dst + i + 8), c);
+		_mm256_storeu_si256((__m256i*)(dst + i + 16), c);
+		_mm256_storeu_si256((__m256i*)(dst + i + 24), c);
+	}
+	for (; i + 8 <= count; i += 8) _mm256_storeu_si256((__m256i*)(dst + i), c);
+	// The tails are legacy-encoded SSE2; entering them with dirty upper
+	// halves costs more than the whole span.
+	_mm256_zeroupper();
+	fillSpanSSE2(dst + i, count - i, color);
+}
+
+__attribute__((target("avx2")))
+static __m256i blend16AVX2(__m256i dst, __m256i inv) {
+	__m256i x = _mm256_add_epi16(_mm256_mullo_epi16(dst, inv), _mm256_set1_epi16(128));
+	return _mm256_srli_epi16(_mm256_add_epi16(x, _mm256_srli_epi16(x, 8)), 8);
+}
+
+__attribute__((target("avx2")))
+static void blendSpanAVX2(u32* dst, const u32* tinted, const u8* coverage, u32 count) {
+	const __m256i zero = _mm256_setzero_si256();
+	const __m256i spread = _mm256_setr_epi8(0, 0, 0, 0, 4, 4, 4, 4, 8, 8, 8, 8, 12, 12, 12, 12,
+	                                        0, 0, 0, 0, 4, 4, 4, 4, 8, 8, 8, 8, 12, 12, 12, 12);
+	u32 i = 0;
+	for (; i + 8 <= count; i += 8) {
+		__m256i d = _mm256_loadu_si256((const __m256i*)(dst + i));
+		__m256i t = _mm256_loadu_si256((const __m256i*)(tinted + i));
+		__m256i a = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*)(coverage + i)));
+		__m256i inv = _mm256_xor_si256(_mm256_shuffle_epi8(a, spread), _mm256_set1_epi8(-1));
+
+		// unpack/pack stay within 128-bit lanes, so pixel order survives.
+		__m256i lo = blend16AVX2(_mm256_unpacklo_epi8(d, zero), _mm256_unpacklo_epi8(inv, zero));
+		__m256i hi = blend16AVX2(_mm256_unpackhi_epi8(d, zero), _mm256_unpackhi_epi8(inv, zero));
+		_mm256_storeu_si256((__m256i*)(dst + i), _mm256_add_epi8(_mm256_packus_epi16(lo, hi), t));
+	}
+	_mm256_zeroupper();
+	blendSpanSSE2(dst + i, tinted + i, coverage + i, count - i);
+}
+#endif
+
+#if defined(RASTER_NEON)
+static void fillSpanNEON(u32* dst, u32 count, u32 color) {
+	const uint32x4_t c = vdupq_n_u32(color);
+	u32 i = 0;
+	for (; i + 16 <= count; i += 16) {
+		vst1q_u32(dst + i + 0, c);
+		vst1q_u32(dst + i + 4, c);
+		vst1q_u32(dst + i + 8, c);
+		vst1q_u32(dst + i + 12, c);
+	}
+	for (; i + 4 <= count; i += 4) vst1q_u32(dst + i, c);
+	fillSpanScalar(dst + i, count - i, color);
+}
+
+static uint8x8_t blendChannelNEON(uint8x8_t dst, uint8x8_t inv, uint8x8_t tinted) {
+	uint16x8_t x = vaddq_u16(vmull_u8(dst, inv), vdupq_n_u16(128));
+	x = vsraq_n_u16(x, x, 8);
+	return vadd_u8(vshrn_n_u16(x, 8), tinted);
+}
+
+static void blendSpanNEON(u32* dst, const u32* tinted, const u8* coverage, u32 count) {
+	u32 i = 0;
+	for (; i + 8 <= count; i += 8) {
+		// vld4 splits the 8 pixels into one register per channel.
+		uint8x8x4_t d = vld4_u8((const u8*)(dst + i));
+		uint8x8x4_t t = vld4_u8((const u8*)(tinted + i));
+		uint8x8_t inv = vmvn_u8(vld1_u8(coverage + i));
+		d.val[0] = blendChannelNEON(d.val[0], inv, t.val[0]);
+		d.val[1] = blendChannelNEON(d.val[1], inv, t.val[1]);
+		d.val[2] = blendChannelNEON(d.val[2], inv, t.val[2]);
+		d.val[3] = blendChannelNEON(d.val[3], inv, t.val[3]);
+		vst4_u8((u8*)(dst + i), d);
+	}
+	blendSpanScalar(dst + i, tinted + i, coverage + i, count - i);
+}
+#endif
+
+bool isRasterKernelSupported(RasterKernel kernel) {
+	const CpuFeatures& cpu = getCpuFeatures();
+	switch (kernel) {
+		case RasterScalar: return true;
+		case RasterSSE2: return cpu.sse2;
+		case RasterAVX2: return cpu.avx2;
+		case RasterNEON: return cpu.neon;
+	}
+	return false;
+}
+
+RasterKernel bestRasterKernel() {
+	static const RasterKernel best = []() {
+		if (isRasterKernelSupported(RasterAVX2)) return RasterAVX2;
+		if (isRasterKernelSupported(RasterNEON)) return RasterNEON;
+		if (isRasterKernelSupported(RasterSSE2)) return RasterSSE2;
+		return RasterScalar;
+	}();
+	return best;
+}
+
+const char* rasterKernelName(RasterKernel kernel) {
+	switch (kernel) {
+		case RasterScalar: return "scalar";
+		case RasterSSE2: return "sse2";
+		case RasterAVX2: return "avx2";
+		case RasterNEON: return "neon";
+	}
+	return "unknown";
+}
+
+const RasterKernels& getRasterKernels(RasterKernel kernel) {
+	DIAG_ASSERT(isRasterKernelSupported(kernel), "getRasterKernels kernel not supported");
+	static const RasterKernels scalar{ fillSpanScalar, blendSpanScalar };
+	switch (kernel) {
+#if defined(RASTER_X86)
+		case RasterSSE2: {
+			static const RasterKernels sse2{ fillSpanSSE2, blendSpanSSE2 };
+			return sse2;
+		}
+		case RasterAVX2: {
+			static const RasterKernels avx2{ fillSpanAVX2, blendSpanAVX2 };
+			return avx2;
+		}
+#endif
+#if defined(RASTER_NEON)
+		case RasterNEON: {
+			static const RasterKernels neon{ fillSpanNEON, blendSpanNEON };
+			return neon;
+		}
+#endif
+		default: return scalar;
+	}
+}
+
+static const RasterKernels* activeKernels = &getRasterKernels(bestRasterKernel());
+
+const RasterKernels& activeRasterKernels() {
+	return *activeKernels;
+}
+
+void selectRasterKernel(RasterKernel kernel) {
+	activeKernels = &getRasterKernels(kernel);
+}
@@ -0,0 +1,30 @@
+#pragma once
+#include "commonTypes.h"
+
+enum RasterKernel {
+	RasterScalar = 0, RasterSSE2 = 1, RasterAVX2 = 2, RasterNEON = 3
+};
+
+// Span primitives the software rasterizer is built from. Every kernel
+// produces the same pixels; they only differ in how many they touch per
+// instruction.
+struct RasterKernels {
+	// dst[0, count) = color
+	void (*fillSpan)(u32* dst, u32 count, u32 color);
+	// dst[i] = blendTinted(dst[i], tinted[i], coverage[i]) for i in [0, count)
+	void (*blendSpan)(u32* dst, const u32* tinted, const u8* coverage, u32 count);
+};
+
+RasterKernel bestRasterKernel();
+
+bool isRasterKernelSupported(RasterKernel kernel);
+
+const char* rasterKernelName(RasterKernel kernel);
+
+const RasterKernels& getRasterKernels(RasterKernel kernel);
+
+// The kernels render.cpp draws with; bestRasterKernel() unless a bench
+// picked another one with selectRasterKernel.
+const RasterKernels& activeRasterKernels();
+
+void selectRasterKernel(RasterKernel kernel);
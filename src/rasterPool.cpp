@@ -0,0 +1,100 @@
+#include "rasterPool.h"
+#include "traceExport.h"
+
+static u64 packRange(u32 begin, u32 end) {
+	return (u64)begin | ((u64)end << 32);
+}
+
+static bool takeFront(TaskRange& range, u32& task) {
+	u64 bounds = range.bounds.load(std::memory_order_acquire);
+	while (true) {
+		u32 begin = (u32)bounds, end = (u32)(bounds >> 32);
+		if (begin >= end) return false;
+		if (range.bounds.compare_exchange_weak(bounds, packRange(begin + 1, end), std::memory_order_acq_rel)) {
+			task = begin;
+			return true;
+		}
+	}
+}
+
+static bool takeBack(TaskRange& range, u32& task) {
+	u64 bounds = range.bounds.load(std::memory_order_acquire);
+	while (true) {
+		u32 begin = (u32)bounds, end = (u32)(bounds >> 32);
+		if (begin >= end) return false;
+		if (range.bounds.compare_exchange_weak(bounds, packRange(begin, end - 1), std::memory_order_acq_rel)) {
+			task = end - 1;
+			return true;
+		}
+	}
+}
+
+// Own slice first, then the back of everyone else's. Nothing is added to a
+// batch once it starts, so one pass over the victims leaves it empty.
+static void drainTasks(RasterPool& pool, u32 self) {
+	u32 participants = (u32)pool.ranges.size();
+	u32 task;
+	while (takeFront(pool.ranges[self], task)) pool.job(pool.ctx, task);
+	for (u32 i = 1; i < participants; i++) {
+		TaskRange& victim = pool.ranges[(self + i) % participants];
+		while (takeBack(victim, task)) pool.job(pool.ctx, task);
+	}
+}
+
+static void workerLoop(RasterPool* pool, u32 self) {
+	TRACE_THREAD_NAME("raster worker");
+	u32 seen = 0;
+	while (true) {
+		pool->generation.wait(seen, std::memory_order_acquire);
+		seen = pool->generation.load(std::memory_order_acquire);
+		if (pool->stopping.load(std::memory_order_acquire)) return;
+
+		{
+			TRACE_SCOPE("rasterTasks");
+			drainTasks(*pool, self);
+		}
+		if (pool->busy.fetch_sub(1, std::memory_order_acq_rel) == 1) pool->busy.notify_one();
+	}
+}
+
+RasterPool* startRasterPool(u32 workerCount) {
+	if (workerCount == 0) return nullptr;
+
+	RasterPool* pool = new RasterPool{};
+	pool->ranges = std::vector<TaskRange>(workerCount + 1);
+	for (u32 i = 0; i < workerCount; i++) pool->workers.emplace_back(workerLoop, pool, i);
+	return pool;
+}
+
+void stopRasterPool(RasterPool* pool) {
+	if (!pool) return;
+
+	pool->stopping.store(true, std::memory_order_release);
+	pool->generation.fetch_add(1, std::memory_order_release);
+	pool->generation.notify_all();
+	for (std::thread& worker : pool->workers) worker.join();
+	delete pool;
+}
+
+void runRasterTasks(RasterPool& pool, u32 taskCount, void (*job)(void* ctx, u32 task), void* ctx) {
+	TRACE_SCOPE("runRasterTasks");
+	u32 participants = (u32)pool.ranges.size();
+	for (u32 i = 0; i < participants; i++) {
+		u32 begin = (u32)((u64)taskCount * i / participants);
+		u32 end = (u32)((u64)taskCount * (i + 1) / participants);
+		pool.ranges[i].bounds.store(packRange(begin, end), std::memory_order_relaxed);
+	}
+	pool.job = job;
+	pool.ctx = ctx;
+	pool.busy.store((u32)pool.workers.size(), std::memory_order_relaxed);
+
+	pool.generation.fetch_add(1, std::memory_order_release);
+	pool.generation.notify_all();
+
+	drainTasks(pool, participants - 1);
+
+	u32 busy;
+	while ((busy = pool.busy.load(std::memory_order_acquire)) != 0) {
+		pool.busy.wait(busy, std::memory_order_acquire);
+	}
+}
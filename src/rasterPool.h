@@ -0,0 +1,39 @@
+#pragma once
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include "commonTypes.h"
+
+// One participant's share of a batch: tasks [begin, end) packed into one
+// word so the owner taking from the front and thieves taking from the back
+// agree through a single CAS.
+struct alignas(64) TaskRange {
+	std::atomic<u64> bounds{0};
+};
+
+// Persistent workers for the per-frame text row tasks. The calling thread
+// joins in as the last participant. Dispatch and completion are atomic
+// counters; idle workers sleep in atomic::wait.
+struct RasterPool {
+	std::vector<std::thread> workers;
+	std::vector<TaskRange> ranges;
+
+	void (*job)(void* ctx, u32 task) = nullptr;
+	void* ctx = nullptr;
+
+	alignas(64) std::atomic<u32> generation{0};
+	alignas(64) std::atomic<u32> busy{0};
+	std::atomic<bool> stopping{false};
+};
+
+// Spawns workerCount threads; returns nullptr for 0, leaving callers on
+// their single-threaded path.
+RasterPool* startRasterPool(u32 workerCount);
+
+void stopRasterPool(RasterPool* pool);
+
+// Runs job(ctx, task) for every task in [0, taskCount) across the pool and
+// the calling thread, returning once all of them are done.
+void runRasterTasks(RasterPool& pool, u32 taskCount, void (*job)(void* ctx, u32 task), void* ctx);
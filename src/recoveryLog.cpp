@@ -0,0 +1,353 @@
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "recoveryLog.h"
+#include "diagnostics.h"
+#include "fileLoader.h"
+#include "mappedFile.h"
+#include "traceExport.h"
+
+constexpr u32 SWAP_VERSION = 2;
+
+struct SwapHeader {
+	char magic[4];
+	u32 version;
+	u64 baseSize;
+	s64 baseMtimeNs;
+};
+
+static RecoveryLog* g_abortLog = nullptr;
+
+static std::string swapPathFor(const std::string& path) {
+	size_t sep = path.find_last_of('/');
+	if (sep == std::string::npos) return "." + path + ".swp";
+	return path.substr(0, sep + 1) + "." + path.substr(sep + 1) + ".swp";
+}
+
+static bool baseHeader(const std::string& path, SwapHeader& header) {
+	struct stat info{};
+	if (stat(path.c_str(), &info) != 0) return false;
+	std::memcpy(header.magic, "CESW", 4);
+	header.version = SWAP_VERSION;
+	header.baseSize = (u64)info.st_size;
+#ifdef __APPLE__
+	const timespec& mtime = info.st_mtimespec;
+#else
+	const timespec& mtime = info.st_mtim;
+#endif
+	header.baseMtimeNs = (s64)mtime.tv_sec * 1000000000 + (s64)mtime.tv_nsec;
+	return true;
+}
+
+// Moves a swap file that cannot be replayed to the first free
+// `.swp.old`, `.swp.old1`, ... next to it, so the edits in it survive a
+// fresh log being started.
+static bool setAsideSwap(const std::string& swapPath, std::string& oldPath) {
+	for (u32 i = 0; i < 100; i++) {
+		oldPath = swapPath + ".old" + (i ? std::to_string(i) : "");
+		if (access(oldPath.c_str(), F_OK) == 0) continue;
+		return rename(swapPath.c_str(), oldPath.c_str()) == 0;
+	}
+	return false;
+}
+
+static void appendHeader(std::vector<char>& out, const SwapHeader& header) {
+	const char* bytes = (const char*)&header;
+	out.insert(out.end(), bytes, bytes + sizeof(header));
+}
+
+static void putVarint(std::vector<char>& out, u32 value) {
+	while (value >= 0x80) {
+		out.push_back((char)(value | 0x80));
+		value >>= 7;
+	}
+	out.push_back((char)value);
+}
+
+static bool getVarint(const char*& p, const char* end, u32& value) {
+	value = 0;
+	for (u32 shift = 0; shift < 35; shift += 7) {
+		if (p == end) return false;
+		u8 byte = (u8)*p++;
+		value |= (u32)(byte & 0x7F) << shift;
+		if (!(byte & 0x80)) return true;
+	}
+	return false;
+}
+
+static bool hasBody(RecoveryOp op) {
+	return op == LogInsertText || op == LogInsertBlock || op == LogRemoveBlock;
+}
+
+static void writeAll(int fd, const char* data, size_t len) {
+	while (len > 0) {
+		ssize_t written = write(fd, data, len);
+		if (written < 0 && errno == EINTR) continue;
+		if (written <= 0) return;
+		data += written;
+		len -= (size_t)written;
+	}
+}
+
+// Batches are not fsynced: the log is there for the editor crashing, and
+// the kernel keeps whatever was written before that.
+static void runRecoveryLog(RecoveryLog* log) {
+	TRACE_THREAD_NAME("recovery log");
+	std::vector<char> batch;
+	std::vector<char> rebase;
+	std::unique_lock<std::mutex> guard(log->lock);
+	while (true) {
+		log->wake.wait(guard, [log]() { return log->stopping || log->rebasing || !log->queued.empty(); });
+		if (!log->rebasing && log->queued.empty()) break;
+
+		bool rebasing = log->rebasing;
+		std::swap(batch, log->queued);
+		std::swap(rebase, log->rebase);
+		log->rebasing = false;
+		log->writing = true;
+		guard.unlock();
+
+		// The fd is O_APPEND, so after the truncate writes start over at 0.
+		{
+			TRACE_SCOPE("writeRecoveryBatch");
+			if (rebasing) {
+				if (ftruncate(log->fd, 0) == 0) writeAll(log->fd, rebase.data(), rebase.size());
+			}
+			writeAll(log->fd, batch.data(), batch.size());
+		}
+		batch.clear();
+		rebase.clear();
+
+		guard.lock();
+		log->writing = false;
+		log->idle.notify_all();
+	}
+}
+
+// diagAbort runs on the UI thread, so the edits of the current frame can
+// still be written behind whatever the worker has in flight.
+static void flushOnAbort() {
+	RecoveryLog* log = g_abortLog;
+	if (!log) return;
+
+	std::unique_lock<std::mutex> guard(log->lock);
+	log->idle.wait(guard, [log]() { return !log->writing; });
+	if (log->rebasing && ftruncate(log->fd, 0) == 0) writeAll(log->fd, log->rebase.data(), log->rebase.size());
+	writeAll(log->fd, log->queued.data(), log->queued.size());
+	writeAll(log->fd, log->pending.data(), log->pending.size());
+}
+
+static bool applyEdit(TextBuffer* text, RecoveryOp op, u32 line, u32 column, std::string_view body, u32 length) {
+	switch (op) {
+		case LogInsertText: {
+			if (line >= text->size) return false;
+			LineBuffer* lb = text->getLineBuffer(line);
+			if (column > lb->size) return false;
+			lb->insertText(column, body);
+			text->lineEdited(line);
+		} break;
+		case LogRemoveText: {
+			if (line >= text->size) return false;
+			LineBuffer* lb = text->getLineBuffer(line);
+			if ((u64)column + length > lb->size) return false;
+			lb->removeRange(column, length);
+			text->lineEdited(line);
+		} break;
+		case LogSplitLine: {
+			if (line >= text->size) return false;
+			LineBuffer* lb = text->getLineBuffer(line);
+			if (column > lb->size) return false;
+			text->insertAtIndex(line + 1);
+			lb->splitAt(column, lb->next);
+			text->lineEdited(line);
+		} break;
+		case LogJoinLine:
+			if (line + 1 >= text->size) return false;
+			text->joinAtIndex(line);
+			break;
+		case LogInsertLine:
+			if (line > text->size) return false;
+			text->insertAtIndex(line);
+			break;
+		case LogRemoveLine:
+			if (line >= text->size || text->size == 1) return false;
+			text->removeAtIndex(line);
+			break;
+		case LogInsertBlock: {
+			if (line >= text->size || column > text->getLineBuffer(line)->size) return false;
+			text->insertBlock(line, column, body);
+			text->lineEdited(line);
+		} break;
+		case LogRemoveBlock: {
+			u32 newlines = (u32)std::count(body.begin(), body.end(), '\n');
+			if ((u64)line + newlines >= text->size) return false;
+			u32 firstLength = (u32)std::min(body.find('\n'), body.size());
+			u32 lineSize = text->getLineBuffer(line)->size;
+			if ((u64)column + firstLength > lineSize || (newlines > 0 && column + firstLength != lineSize)) return false;
+			u32 lastLength = (u32)(body.size() - body.rfind('\n') - 1);
+			if (newlines > 0 && lastLength > text->getLineBuffer(line + newlines)->size) return false;
+			text->removeBlock(line, column, body);
+			text->lineEdited(line);
+		} break;
+		default: return false;
+	}
+	return true;
+}
+
+// Applies records until the end or the first one that is cut short or does
+// not fit the text; `end` is left just past the last one applied.
+static s32 replayEdits(TextBuffer* text, const char* begin, const char* limit, const char*& end) {
+	s32 replayed = 0;
+	const char* p = begin;
+	end = begin;
+	while (p < limit) {
+		RecoveryOp op = (RecoveryOp)(u8)*p++;
+		u32 line, column, length;
+		if (!getVarint(p, limit, line) || !getVarint(p, limit, column) || !getVarint(p, limit, length)) break;
+
+		std::string_view body;
+		if (hasBody(op)) {
+			if ((size_t)(limit - p) < length) break;
+			body = std::string_view(p, length);
+			p += length;
+		}
+		if (!applyEdit(text, op, line, column, body, length)) break;
+		end = p;
+		replayed++;
+	}
+	return replayed;
+}
+
+s32 startRecoveryLog(EditorState& st) {
+	SwapHeader header{};
+	if (!baseHeader(st.currentFilePath, header)) return ERR_FILE_NOT_FOUND;
+
+	RecoveryLog* log = new RecoveryLog{};
+	log->swapPath = swapPathFor(st.currentFilePath);
+
+	s32 replayed = 0;
+	u64 keep = 0;
+	MappedFile swap{};
+	if (mapFile(swap, log->swapPath) == OK && swap.size >= sizeof(SwapHeader)) {
+		if (std::memcmp(swap.data, &header, sizeof(header)) == 0) {
+			waitForLoadedLines(st, UINT32_MAX);
+			const char* end;
+			replayed = replayEdits(st.Text, swap.data + sizeof(header), swap.data + swap.size, end);
+			keep = (u64)(end - swap.data);
+		}
+		else {
+			std::string oldPath;
+			unmapFile(swap);
+			if (!setAsideSwap(log->swapPath, oldPath)) {
+				std::fprintf(stderr, "%s was written for another version of %s; not logging edits so it is kept\n",
+				             log->swapPath.c_str(), st.currentFilePath.c_str());
+				delete log;
+				return ERR_IO;
+			}
+			std::fprintf(stderr, "%s was written for another version of %s; its edits are kept in %s\n",
+			             log->swapPath.c_str(), st.currentFilePath.c_str(), oldPath.c_str());
+		}
+	}
+	unmapFile(swap);
+
+	log->fd = open(log->swapPath.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0600);
+	if (log->fd < 0) {
+		delete log;
+		return ERR_IO;
+	}
+	// A record torn by the crash is cut off so new ones follow the last good one.
+	if (ftruncate(log->fd, (off_t)keep) != 0) {
+		close(log->fd);
+		delete log;
+		return ERR_IO;
+	}
+	if (keep == 0) appendHeader(log->pending, header);
+
+	if (replayed > 0) st.isDirty = true;
+
+	log->worker = std::thread(runRecoveryLog, log);
+	st.recovery = log;
+	g_abortLog = log;
+	diagSetAbortHook(flushOnAbort);
+	return replayed;
+}
+
+void logEdit(EditorState& st, RecoveryOp op, u32 line, u32 column, std::string_view text) {
+	RecoveryLog* log = st.recovery;
+	if (!log) return;
+
+	size_t start = log->pending.size();
+	log->pending.push_back((char)op);
+	putVarint(log->pending, line);
+	putVarint(log->pending, column);
+	putVarint(log->pending, (u32)text.size());
+	if (hasBody(op)) log->pending.insert(log->pending.end(), text.begin(), text.end());
+
+	if (log->trackingSave) log->sinceSave.insert(log->sinceSave.end(), log->pending.begin() + (ptrdiff_t)start, log->pending.end());
+}
+
+void flushRecoveryLog(EditorState& st) {
+	RecoveryLog* log = st.recovery;
+	if (!log || log->pending.empty()) return;
+	{
+		std::lock_guard<std::mutex> guard(log->lock);
+		log->queued.insert(log->queued.end(), log->pending.begin(), log->pending.end());
+	}
+	log->pending.clear();
+	log->wake.notify_one();
+}
+
+void checkpointRecoveryLog(EditorState& st) {
+	RecoveryLog* log = st.recovery;
+	if (!log) return;
+	log->sinceSave.clear();
+	log->trackingSave = true;
+}
+
+// Once the save is on disk the log restarts from it, keeping only the edits
+// made while it was being flushed. Whatever is still queued is older than
+// the checkpoint or already in sinceSave, so it is dropped.
+void rebaseRecoveryLog(EditorState& st, bool saved) {
+	RecoveryLog* log = st.recovery;
+	if (!log || !log->trackingSave) return;
+	log->trackingSave = false;
+
+	SwapHeader header{};
+	if (saved && baseHeader(st.currentFilePath, header)) {
+		std::lock_guard<std::mutex> guard(log->lock);
+		log->rebase.clear();
+		appendHeader(log->rebase, header);
+		log->rebase.insert(log->rebase.end(), log->sinceSave.begin(), log->sinceSave.end());
+		log->rebasing = true;
+		log->queued.clear();
+		log->pending.clear();
+	}
+	log->sinceSave.clear();
+	log->wake.notify_one();
+}
+
+void closeRecoveryLog(EditorState& st) {
+	RecoveryLog* log = st.recovery;
+	if (!log) return;
+
+	flushRecoveryLog(st);
+	{
+		std::lock_guard<std::mutex> guard(log->lock);
+		log->stopping = true;
+	}
+	log->wake.notify_one();
+	log->worker.join();
+
+	diagSetAbortHook(nullptr);
+	g_abortLog = nullptr;
+	close(log->fd);
+	if (!st.isDirty) unlink(log->swapPath.c_str());
+	delete log;
+	st.recovery = nullptr;
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include "config.h"
+
+enum RecoveryOp : u8 {
+	LogInsertText = 1, LogRemoveText = 2, LogSplitLine = 3, LogJoinLine = 4, LogInsertLine = 5, LogRemoveLine = 6,
+	LogInsertBlock = 7, LogRemoveBlock = 8
+};
+
+// Swap file next to st.currentFilePath holding every edit since the file was
+// last saved. Edits are encoded on the UI thread into `pending`, handed to
+// the worker once per frame and appended there, so a crash loses at most
+// the current frame. The header names the saved file by size and mtime in
+// nanoseconds; a swap written for any other version of it is not replayed
+// but moved aside to `.swp.old`.
+struct RecoveryLog {
+	std::thread worker;
+	std::mutex lock;
+	std::condition_variable wake;
+	std::condition_variable idle;
+	std::vector<char> queued;
+	std::vector<char> rebase;
+	bool rebasing = false;
+	bool writing = false;
+	bool stopping = false;
+
+	int fd = -1;
+	std::string swapPath;
+	std::vector<char> pending;
+
+	// Edits since the current save started; they become the whole log once
+	// that save is on disk.
+	std::vector<char> sinceSave;
+	bool trackingSave = false;
+};
+
+// Replays a swap file left by a crash onto st.Text, then keeps logging to
+// it. Returns the number of edits replayed, or an error code.
+s32 startRecoveryLog(EditorState& st);
+
+// Text removals only store the length of `text`; block edits store the
+// text either way, since its newlines give the shape of what to remove.
+void logEdit(EditorState& st, RecoveryOp op, u32 line, u32 column, std::string_view text = {});
+
+// Hands the edits of this frame to the worker.
+void flushRecoveryLog(EditorState& st);
+
+// Called once a save has captured the text, and again when it is durable.
+void checkpointRecoveryLog(EditorState& st);
+
+void rebaseRecoveryLog(EditorState& st, bool saved);
+
+// Drops the swap file unless there are unsaved edits.
+void closeRecoveryLog(EditorState& st);
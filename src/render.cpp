@@ -1,176 +1,432 @@
 #include "render.h"
 #include "config.h"
 #include "diagnostics.h"
+#include "fileLoader.h"
+#include "rasterKernels.h"
+#include "rasterPool.h"
+#include "profiler.h"
 #include <print>
 #include <algorithm>
+#include <cstdio>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <span>
+
+// Screen rows [top, bottom) and columns [left, right) a draw call may
+// touch. Text rows are clipped to their own band, so a single row can be
+// cleared and redrawn on its own.
+struct ClipBand {
+	u32 top, bottom;
+	u32 left = 0, right = UINT32_MAX;
+};
+
+static ClipBand screenBand(EditorState& st) {
+	return { 0, st.screenBuf.height };
+}
 
-void renderCharacter(EditorState& st, char character, u32 xPos, u32 yPos, u32 color) {
-	DIAG_ASSERT(character >= 32 && character <= 126, "renderCharacter non-printable character");
-	Glyph g = *st.Font.getGlyph(character);
-
-	for (u32 y = 0; y < (u32)g.h; y++) {
-		for (u32 x = 0; x < (u32)g.w; x++) {
-			u32 srcX = (u32)g.x + x;
-			u32 srcY = (u32)g.y + y;
+static ClipBand rowBand(u32 row) {
+	u32 top = TPAD + row * LINE_HEIGHT;
+	return { top, top + LINE_HEIGHT };
+}
 
-			if (!st.TgaFontImg.pixels[srcX + srcY * st.TgaFontImg.width]) continue;
+static bool isRowDirty(EditorState& st, u32 row) {
+	return row < st.damage.rows.size() && st.damage.rows[row];
+}
 
-			s32 dstX = (s32)xPos + (s32)g.xOffset + (s32)x;
-			s32 dstY = (s32)yPos + (s32)g.yOffset + (s32)y;
+static void drawGlyph(EditorState& st, const GlyphMask* g, const GlyphTint& tint, s32 xPos, s32 yPos, ClipBand clip) {
+	s32 left = xPos + (s32)g->xOffset;
+	s32 top = yPos + (s32)g->yOffset;
+	s32 xBegin = std::max(0, (s32)clip.left - left);
+	s32 xEnd = std::min((s32)g->w, (s32)std::min(clip.right, st.screenBuf.width) - left);
+	s32 yBegin = std::max(0, (s32)clip.top - top);
+	s32 yEnd = std::min((s32)g->h, (s32)clip.bottom - top);
+
+	if (xBegin >= xEnd) return;
+
+	const RasterKernels& raster = activeRasterKernels();
+	for (s32 y = yBegin; y < yEnd; y++) {
+		u32 src = g->offset + (u32)(y * (s32)g->w + xBegin);
+		u32* dst = st.screenBuf.row((u32)(top + y)) + (left + xBegin);
+		raster.blendSpan(dst, tint.pixels.data() + src, st.Glyphs.coverage.data() + src, (u32)(xEnd - xBegin));
+	}
+}
 
-			st.screenBuf.pixels[dstX + dstY * (s32)st.screenBuf.width] = color;
+static u32 drawString(EditorState& st, std::string_view str, u32 xPos, u32 yPos, u32 color, ClipBand clip) {
+	const GlyphTint& tint = getGlyphTint(st.Glyphs, color);
+	const GlyphMask* spaceGlyph = st.Glyphs.getGlyph(' ');
+	u32 right = std::min(clip.right, st.screenBuf.width);
+	for (char c : str) {
+		if (xPos >= right) break;
+		if (c == '\t') {
+			xPos += (u32)spaceGlyph->xAdvance * TAB_SIZE;
+			continue;
 		}
+
+		const GlyphMask* g = st.Glyphs.getGlyph(c);
+		drawGlyph(st, g, tint, (s32)xPos, (s32)yPos, clip);
+		xPos += (u32)g->xAdvance;
 	}
+	return xPos;
+}
+
+void renderCharacter(EditorState& st, char character, u32 xPos, u32 yPos, u32 color) {
+	DIAG_ASSERT(character >= 32 && character <= 126, "renderCharacter non-printable character");
+	drawGlyph(st, st.Glyphs.getGlyph(character), getGlyphTint(st.Glyphs, color), (s32)xPos, (s32)yPos, screenBand(st));
 }
 
 void renderNumber(EditorState& st, std::string_view number, u32 xPos, u32 yPos, u32 color) {
-	for (char c : number) {
+	for ([[maybe_unused]] char c : number) {
 		DIAG_ASSERT(c >= '0' && c <= '9', "renderNumber received non-digit");
-		Glyph g = *st.Font.getGlyph(c);
+	}
+	drawString(st, number, xPos, yPos, color, screenBand(st));
+}
 
-		for (u32 y = 0; y < (u32)g.h; y++) {
-			for (u32 x = 0; x < (u32)g.w; x++) {
-				u32 srcX = (u32)g.x + x;
-				u32 srcY = (u32)g.y + y;
+u32 renderString(EditorState& st, std::string_view str, u32 xPos, u32 yPos, u32 color) {
+	return drawString(st, str, xPos, yPos, color, screenBand(st));
+}
 
-				if (!st.TgaFontImg.pixels[srcX + srcY * st.TgaFontImg.width]) continue;
+static u32 tokenColor(TokenKind kind, u32 textColor) {
+	switch (kind) {
+		case TokenKeyword: return LIGHT_BLUE;
+		case TokenType: return CYAN;
+		case TokenNumber: return ORANGE;
+		case TokenString: return YELLOW;
+		case TokenComment: return GRAY_50;
+		case TokenPreprocessor: return MAGENTA;
+		case TokenText: break;
+	}
+	return textColor;
+}
 
-				s32 dstX = (s32)xPos + (s32)g.xOffset + (s32)x;
-				s32 dstY = (s32)yPos + (s32)g.yOffset + (s32)y;
+// Draws columns [from, to) of lb, which may straddle the gap.
+static u32 drawColumns(EditorState& st, const LineBuffer* lb, u32 from, u32 to, u32 xPos, u32 yPos, u32 color, ClipBand clip) {
+	std::string_view head = lb->head();
+	u32 split = (u32)head.size();
+	if (from < split) xPos = drawString(st, head.substr(from, std::min(to, split) - from), xPos, yPos, color, clip);
+	if (to > split) {
+		u32 start = std::max(from, split);
+		xPos = drawString(st, lb->tail().substr(start - split, to - start), xPos, yPos, color, clip);
+	}
+	return xPos;
+}
 
-				st.screenBuf.pixels[dstX + dstY * (s32)st.screenBuf.width] = color;
+// Draws lb scrolled left by st.ScrollX, clipped at xPos, in `color` except
+// where tokens say otherwise. Columns scrolled out of view are skipped by
+// searching the layout, not by walking them.
+static void renderLine(EditorState& st, const LineBuffer* lb, const LineLayout& layout, std::span<const TokenSpan> tokens, u32 xPos, u32 yPos, u32 color, ClipBand clip) {
+	u32 column = firstVisibleColumn(layout, st.ScrollX);
+	while (column < lb->size && xPos + layout.x[column] < st.ScrollX) column++;
+	if (column >= lb->size) return;
+
+	clip.left = xPos;
+	xPos = xPos + layout.x[column] - st.ScrollX;
+	u32 right = std::min(clip.right, st.screenBuf.width);
+	auto token = tokens.begin();
+	while (token != tokens.end() && token->start + token->length <= column) ++token;
+
+	while (column < lb->size && xPos < right) {
+		u32 end = lb->size;
+		u32 runColor = color;
+		if (token != tokens.end()) {
+			if (token->start <= column) {
+				end = token->start + token->length;
+				runColor = tokenColor(token->kind, color);
+				++token;
+			}
+			else {
+				end = token->start;
 			}
 		}
-		xPos += (u32)g.xAdvance;
+		xPos = drawColumns(st, lb, column, end, xPos, yPos, runColor, clip);
+		column = end;
 	}
 }
 
-void renderString(EditorState& st, std::string_view str, u32 xPos, u32 yPos, u32 color) {
-	Glyph spaceGlyph = *st.Font.getGlyph(' ');
+static void fillRows(EditorState& st, u32 yStart, u32 yEnd, u32 color) {
+	const RasterKernels& raster = activeRasterKernels();
+	for (u32 y = yStart; y < yEnd; y++) {
+		raster.fillSpan(st.screenBuf.row(y), st.screenBuf.width, color);
+	}
+}
+
+static u32 getStringWidth(EditorState& st, std::string_view str) {
+	u32 width = 0;
 	for (char c : str) {
-		if (c == '\t') {
-			xPos += (u32)spaceGlyph.xAdvance * TAB_SIZE;
-			continue;
-		}
+		width += st.Glyphs.getGlyph(c)->xAdvance;
+	}
+	return width;
+}
 
-		Glyph g = *st.Font.getGlyph(c);
+static void renderCursor(EditorState& st, const LineLayout& layout, u32 yPos, u32 color) {
+	u32 cursorX = layout.x[std::min(st.CursorPos, (u32)layout.x.size() - 1)];
+	if (cursorX < st.ScrollX) return;
 
-		for (u32 y = 0; y < (u32)g.h; y++) {
-			for (u32 x = 0; x < (u32)g.w; x++) {
-				u32 srcX = (u32)g.x + x;
-				u32 srcY = (u32)g.y + y;
+	u32 xPos = LPAD + TEXT_LPAD + cursorX - st.ScrollX;
+	if (xPos >= st.screenBuf.width) return;
+	u32 width = st.CurrMode == InsertMode ? 1 : std::min(DEFAULT_CHAR_WIDTH, st.screenBuf.width - xPos);
+	const RasterKernels& raster = activeRasterKernels();
+	for (u32 y = 1; y < LINE_HEIGHT-1; y++) {
+		raster.fillSpan(st.screenBuf.row(yPos + y) + xPos, width, color);
+	}
+}
 
-				if (!st.TgaFontImg.pixels[srcX + srcY * st.TgaFontImg.width]) continue;
+// Keeps the cursor column inside the text area.
+static void scrollToCursor(EditorState& st) {
+	if (!st.CurrLineBuffer) return;
+	const LineLayout& layout = getLineLayout(st.Layouts, st.Glyphs, st.CurrLineBuffer);
+	u32 cursorX = layout.x[std::min(st.CursorPos, st.CurrLineBuffer->size)];
 
-				s32 dstX = (s32)xPos + (s32)g.xOffset + (s32)x;
-				s32 dstY = (s32)yPos + (s32)g.yOffset + (s32)y;
+	u32 textLeft = LPAD + TEXT_LPAD;
+	u32 viewWidth = st.screenBuf.width > textLeft + DEFAULT_CHAR_WIDTH ? st.screenBuf.width - textLeft - DEFAULT_CHAR_WIDTH : 0;
+	if (cursorX < st.ScrollX) st.ScrollX = cursorX;
+	else if (cursorX > st.ScrollX + viewWidth) st.ScrollX = cursorX - viewWidth;
+}
 
-				st.screenBuf.pixels[dstX + dstY * (s32)st.screenBuf.width] = color;
-			}
-		}
-		xPos += (u32)g.xAdvance;
-	}
+void resizeOffscreenBuffer(OffscreenBuffer& buf, u32 width, u32 height) {
+	freeOffscreenBuffer(buf);
+	buf.width = width;
+	buf.height = height;
+	buf.pitch = (width * 4 + 63) & ~63u;
+	buf.pixels = (u32*)std::aligned_alloc(64, (size_t)buf.pitch * height);
 }
 
-void renderLineNumbers(EditorState& st) {
-	for (u32 i = 0; i < st.DisplayedLineCount; i++) {
-		std::string s = std::to_string(st.TopLine + i + 1);
+void freeOffscreenBuffer(OffscreenBuffer& buf) {
+	std::free(buf.pixels);
+	buf.pixels = nullptr;
+}
 
-		s32 totalW = 0;
-		for (char c : s) totalW += (*st.Font.getGlyph(c)).xAdvance;
+void markLineDirty(EditorState& st, u32 line) {
+	if (line < st.TopLine) return;
+	u32 row = line - st.TopLine;
+	if (row < st.damage.rows.size()) st.damage.rows[row] = 1;
+}
 
-		u32 color = (st.TopLine + i == st.CurrLine) ? LIGHT_GREEN : DARK_GREEN;
-		renderNumber(st, s, LPAD + LINE_NUM_LPAD - (u32)totalW, (i * LINE_HEIGHT) + TPAD + LINE_NUM_TPAD, color);
-	}
+void markLinesDirtyFrom(EditorState& st, u32 line) {
+	u32 row = line > st.TopLine ? line - st.TopLine : 0;
+	for (; row < st.damage.rows.size(); row++) st.damage.rows[row] = 1;
 }
 
-void renderLineSeparators(EditorState& st) {
-	u8* pixels = (u8*)st.screenBuf.pixels + (st.screenBuf.pitch * TPAD);
+void markAllDirty(EditorState& st) {
+	st.damage.full = true;
+}
 
-	for (u32 i = 0; i < st.DisplayedLineCount; i++) {
-		for (u32 j = 0; j < st.screenBuf.width; j++) {
-			u32* p = (u32*)(pixels + ((i * LINE_HEIGHT) * st.screenBuf.pitch) + (j * 4));
-			*p = DARK_GREEN;
-		}
+void beginFrame(EditorState& st) {
+	PROFILE_SCOPE(ProfileBeginFrame);
+	FrameDamage& damage = st.damage;
+	trimLayoutCache(st.Layouts, st.MaxDisplayedLineCount);
+	scrollToCursor(st);
+	if (damage.rows.size() != st.MaxDisplayedLineCount) {
+		damage.rows.assign(st.MaxDisplayedLineCount, 0);
+		damage.full = true;
 	}
-}
+	updateHighlight(st, st.TopLine + st.DisplayedLineCount);
 
-void renderSelectedLine(EditorState& st) {
-	u32 yPos = TPAD + (st.CurrLine - st.TopLine) * LINE_HEIGHT;
-	for (u32 y = 0; y < LINE_HEIGHT; y++) {
-		for (u32 x = 0; x < st.screenBuf.width; x++) {
-			st.screenBuf.pixels[x + (y + yPos) * st.screenBuf.width] = SELECTED_LINE_BG;
-		}
+	if (st.TopLine != damage.lastTopLine || st.DisplayedLineCount != damage.lastDisplayedLineCount) {
+		damage.full = true;
+	}
+	if (st.ScrollX != damage.lastScrollX) damage.full = true;
+	if (st.Search.highlightRevision != damage.lastHighlightRevision) damage.full = true;
+	if (st.CurrLine != damage.lastCurrLine) {
+		markLineDirty(st, damage.lastCurrLine);
+		markLineDirty(st, st.CurrLine);
+	}
+	else if (st.CursorPos != damage.lastCursorPos || st.CurrMode != damage.lastMode) {
+		markLineDirty(st, st.CurrLine);
 	}
-}
 
-void renderSelectedPosition(EditorState& st, u32 color) {
+	PROFILE_SCOPE(ProfileClear);
+	if (damage.full) {
+		std::fill(damage.rows.begin(), damage.rows.end(), 1);
+		std::memset(st.screenBuf.pixels, 0, (size_t)st.screenBuf.pitch * (size_t)st.screenBuf.height);
+		return;
+	}
 
-	u32 xPos = LPAD + TEXT_LPAD;
-	u32 yPos = TPAD;
-	LineBuffer* lb = st.Text->getLineBuffer(st.TopLine);
-	Glyph spaceGlyph = *st.Font.getGlyph(' ');
+	for (u32 row = 0; row < damage.rows.size(); row++) {
+		if (!damage.rows[row]) continue;
+		ClipBand band = rowBand(row);
+		std::memset(st.screenBuf.row(band.top), 0, (size_t)st.screenBuf.pitch * LINE_HEIGHT);
+	}
+}
 
-	for (u32 i = 0; i < st.DisplayedLineCount; i++) {
-		if (lb == st.CurrLineBuffer) break;
-		renderString(st, lb->text, LPAD + TEXT_LPAD, TPAD + TEXT_TPAD + i * LINE_HEIGHT, DARK_GREEN);
-		if (lb->next == nullptr) break;
-		lb = lb->next;
-		yPos += LINE_HEIGHT;
+void collectDirtyRects(EditorState& st, std::vector<DirtyRect>& rects) {
+	PROFILE_SCOPE(ProfileDirtyRects);
+	rects.clear();
+	u32 barTop = st.screenBuf.height - BPAD;
+	if (st.damage.full) {
+		rects.push_back({ 0, st.screenBuf.height });
+		return;
 	}
 
-	for (u32 i = 0; i < st.CursorPos; i++) {
-		char c = lb->text[i];
-		if (c == '\t') {
-			xPos += (u32)spaceGlyph.xAdvance * TAB_SIZE;
-			continue;
-		}
-		Glyph g = *st.Font.getGlyph(c);
-		xPos += (u32)g.xAdvance;
+	const std::vector<u8>& rows = st.damage.rows;
+	for (u32 row = 0; row < rows.size(); row++) {
+		if (!rows[row]) continue;
+		u32 first = row;
+		while (row + 1 < rows.size() && rows[row + 1]) row++;
+		u32 top = rowBand(first).top;
+		rects.push_back({ top, rowBand(row).bottom - top });
 	}
 
-	for (u32 x = 0; x < DEFAULT_CHAR_WIDTH; x++) {
-		for (u32 y = 1; y < LINE_HEIGHT-1; y++) {
-			st.screenBuf.pixels[xPos + x + (yPos + y) * (s32)st.screenBuf.width] = color;
+	// The status bar carries per-frame stats, so it goes out every frame.
+	if (!rects.empty() && rects.back().y + rects.back().h == barTop) rects.back().h += BPAD;
+	else rects.push_back({ barTop, BPAD });
+}
+
+bool hasDamage(const EditorState& st) {
+	const FrameDamage& damage = st.damage;
+	if (damage.full) return true;
+	if (st.TopLine != damage.lastTopLine || st.DisplayedLineCount != damage.lastDisplayedLineCount) return true;
+	if (st.CurrLine != damage.lastCurrLine || st.CursorPos != damage.lastCursorPos) return true;
+	if (st.CurrMode != damage.lastMode) return true;
+	if (st.isDirty != damage.lastIsDirty || (st.pendingSave != nullptr) != damage.lastSaving) return true;
+	if (st.Search.revision != damage.lastSearchRevision) return true;
+	return std::find(damage.rows.begin(), damage.rows.end(), 1) != damage.rows.end();
+}
+
+void endFrame(EditorState& st) {
+	PROFILE_SCOPE(ProfileEndFrame);
+	FrameDamage& damage = st.damage;
+	std::fill(damage.rows.begin(), damage.rows.end(), 0);
+	damage.full = false;
+	damage.lastTopLine = st.TopLine;
+	damage.lastCurrLine = st.CurrLine;
+	damage.lastCursorPos = st.CursorPos;
+	damage.lastScrollX = st.ScrollX;
+	damage.lastMode = st.CurrMode;
+	damage.lastIsDirty = st.isDirty;
+	damage.lastSaving = st.pendingSave != nullptr;
+	damage.lastSearchRevision = st.Search.revision;
+	damage.lastHighlightRevision = st.Search.highlightRevision;
+	damage.lastDisplayedLineCount = st.DisplayedLineCount;
+}
+
+// Match backgrounds go under the text; the one the cursor is on stands out.
+static void renderMatches(EditorState& st, const LineLayout& layout, u32 line, std::span<const SearchMatch> matches, ClipBand band) {
+	const RasterKernels& raster = activeRasterKernels();
+	u32 textLeft = LPAD + TEXT_LPAD;
+	for (const SearchMatch& m : matches) {
+		u32 x0 = layout.x[m.column];
+		u32 x1 = layout.x[std::min(m.column + m.length, (u32)layout.x.size() - 1)];
+		if (x1 <= st.ScrollX) continue;
+		u32 left = textLeft + std::max(x0, st.ScrollX) - st.ScrollX;
+		u32 right = std::min(textLeft + x1 - st.ScrollX, st.screenBuf.width);
+		if (left >= right) continue;
+
+		bool current = line == st.CurrLine && m.column == st.CursorPos;
+		u32 color = current ? CURRENT_MATCH_BG : SEARCH_MATCH_BG;
+		for (u32 y = band.top + 1; y < band.bottom - 1; y++) {
+			raster.fillSpan(st.screenBuf.row(y) + left, right - left, color);
 		}
-		if (st.CurrMode == InsertMode) break;
 	}
 }
 
-void renderTextBuffer(EditorState& st) {
-	LineBuffer* lb = st.Text->getLineBuffer(st.TopLine);
+// Everything drawn on one text row, in the order the row is layered. Rows
+// only touch their own band, so any set of rows can be drawn in any order
+// or at the same time with the same result.
+static void renderRow(EditorState& st, u32 row, const LineBuffer* lb, const LineLayout& layout, std::span<const SearchMatch> matches, std::span<const TokenSpan> tokens) {
+	ClipBand band = rowBand(row);
+	bool current = st.TopLine + row == st.CurrLine;
+	if (current) fillRows(st, band.top, band.bottom, SELECTED_LINE_BG);
+	fillRows(st, band.top, band.top + 1, DARK_GREEN);
+
+	std::string number = std::to_string(st.TopLine + row + 1);
+	u32 numberWidth = getStringWidth(st, number);
+	drawString(st, number, LPAD + LINE_NUM_LPAD - numberWidth, band.top + LINE_NUM_TPAD, current ? LIGHT_GREEN : DARK_GREEN, band);
+
+	renderMatches(st, layout, st.TopLine + row, matches, band);
+	if (current) renderCursor(st, layout, band.top, GRAY_70);
+	renderLine(st, lb, layout, tokens, LPAD + TEXT_LPAD, band.top + TEXT_TPAD, DARK_GREEN, band);
+}
+
+struct RowTasks {
+	EditorState* st;
+	const u32* rows;
+	const LineBuffer* const* lines;
+	const LineLayout* const* layouts;
+	const SearchMatch* matches;
+	const u32* matchStart;
+	const TokenSpan* tokens;
+	const u32* tokenStart;
+};
+
+static void renderRowTask(void* ctx, u32 task) {
+	RowTasks* tasks = (RowTasks*)ctx;
+	u32 row = tasks->rows[task];
+	std::span<const SearchMatch> matches(tasks->matches + tasks->matchStart[row], tasks->matches + tasks->matchStart[row + 1]);
+	std::span<const TokenSpan> tokens(tasks->tokens + tasks->tokenStart[row], tasks->tokens + tasks->tokenStart[row + 1]);
+	renderRow(*tasks->st, row, tasks->lines[row], *tasks->layouts[row], matches, tokens);
+}
 
+void renderTextRows(EditorState& st) {
+	PROFILE_SCOPE(ProfileTextRows);
+	std::vector<const LineBuffer*> lines;
+	std::vector<const LineLayout*> layouts;
+	std::vector<u32> rows;
+	std::vector<SearchMatch> matches;
+	std::vector<u32> matchStart;
+	std::vector<TokenSpan> tokens;
+	std::vector<u32> tokenStart;
+	const LineBuffer* lb = st.DisplayedLineCount ? st.Text->getLineBuffer(st.TopLine) : nullptr;
 	for (u32 i = 0; i < st.DisplayedLineCount && lb; i++) {
-		renderString(st, lb->text, LPAD + TEXT_LPAD, TPAD + TEXT_TPAD + i * LINE_HEIGHT, DARK_GREEN);
+		bool dirty = isRowDirty(st, i);
+		lines.push_back(lb);
+		layouts.push_back(dirty ? &getLineLayout(st.Layouts, st.Glyphs, lb) : nullptr);
+		matchStart.push_back((u32)matches.size());
+		tokenStart.push_back((u32)tokens.size());
+		if (dirty) {
+			rows.push_back(i);
+			lineMatches(st, st.TopLine + i, lb, matches);
+			lineTokens(st, st.TopLine + i, lb, tokens);
+		}
 		lb = lb->next;
 	}
-}
-
-static u32 getStringWidth(EditorState& st, std::string_view str) {
-	u32 width = 0;
-	for (char c : str) {
-		Glyph g = *st.Font.getGlyph(c);
-		width += g.xAdvance;
+	matchStart.push_back((u32)matches.size());
+	tokenStart.push_back((u32)tokens.size());
+
+	if (!st.rasterPool || rows.size() < RASTER_MIN_PARALLEL_ROWS) {
+		for (u32 row : rows) {
+			std::span<const SearchMatch> rowMatches(matches.data() + matchStart[row], matches.data() + matchStart[row + 1]);
+			std::span<const TokenSpan> rowTokens(tokens.data() + tokenStart[row], tokens.data() + tokenStart[row + 1]);
+			renderRow(st, row, lines[row], *layouts[row], rowMatches, rowTokens);
+		}
+		return;
 	}
-	return width;
+
+	// Workers only read the glyph and layout caches: layouts were built
+	// above and every row color is created here.
+	getGlyphTint(st.Glyphs, DARK_GREEN);
+	getGlyphTint(st.Glyphs, LIGHT_GREEN);
+	for (u8 kind = TokenKeyword; kind <= TokenPreprocessor; kind++) getGlyphTint(st.Glyphs, tokenColor((TokenKind)kind, DARK_GREEN));
+
+	RowTasks tasks{ &st, rows.data(), lines.data(), layouts.data(), matches.data(), matchStart.data(), tokens.data(), tokenStart.data() };
+	runRasterTasks(*st.rasterPool, (u32)rows.size(), renderRowTask, &tasks);
 }
 
-void renderBottom(EditorState& st, u32 fps) {
+void renderBottom(EditorState& st, f32 frameMs) {
+	PROFILE_SCOPE(ProfileBottom);
 	u32 yStart = st.screenBuf.height - BPAD;
-	for (u32 y = yStart; y < st.screenBuf.height; y++) {
-		for (u32 x = 0; x < st.screenBuf.width; x++) {
-			st.screenBuf.pixels[x + y * st.screenBuf.width] = GRAY_10;
-		}
-	}
+	fillRows(st, yStart, st.screenBuf.height, GRAY_10);
 
 	std::string modeLabel = "MODE: ";
 	switch (st.CurrMode) {
 		case NormalMode: modeLabel += "Normal"; break;
 		case InsertMode: modeLabel += "Insert"; break;
 		case VisualMode: modeLabel += "Visual"; break;
+		case SearchMode: modeLabel += "Search"; break;
 	}
 
 	std::string lineLabel = "Ln " + std::to_string(st.CurrLine + 1) + ", Col " + std::to_string(st.CursorPos + 1);
+	u32 lineColor = LIGHT_BLUE;
+	if (st.CurrMode == SearchMode) {
+		lineLabel = "/" + st.Search.query;
+		if (!st.Search.valid && !st.Search.query.empty()) lineColor = LIGHT_RED;
+	}
+	if (st.Search.valid) {
+		// N keeps a + while the scan is still counting.
+		std::string total = std::to_string(st.Search.matches.size()) + (st.Search.scanning ? "+" : "");
+		u32 k = currentMatchNumber(st);
+		lineLabel += k ? "   match " + std::to_string(k) + " of " + total : "   " + total + " matches";
+	}
 
 	std::string fileLabel = "File: ";
 	if (!st.currentFileName.empty()) fileLabel += st.currentFileName;
@@ -178,8 +434,18 @@ void renderBottom(EditorState& st, u32 fps) {
 
 	std::string saveLabel = st.isDirty ? "Unsaved" : "Saved";
 	u32 saveColor = st.isDirty ? LIGHT_RED : LIGHT_GREEN;
+	if (st.pendingSave) {
+		saveLabel = "Saving";
+		saveColor = YELLOW;
+	}
+	if (st.pendingLoad) {
+		saveLabel = "Loading " + std::to_string((u32)(fileLoadProgress(st) * 100.0f)) + "%";
+		saveColor = YELLOW;
+	}
 
-	std::string fpsLabel = "FPS " + std::to_string(fps);
+	char frameText[32];
+	std::snprintf(frameText, sizeof(frameText), "Frame %.2f ms", (f64)frameMs);
+	std::string fpsLabel = frameText;
 
 	u32 textY = yStart + 12;
 	u32 modeX = MODE_LPAD;
@@ -206,8 +472,88 @@ void renderBottom(EditorState& st, u32 fps) {
 	fileX = std::min(fileX, maxFileX);
 
 	renderString(st, modeLabel, modeX, textY, LIGHT_GREEN);
-	renderString(st, lineLabel, lineX, textY, LIGHT_BLUE);
+	renderString(st, lineLabel, lineX, textY, lineColor);
 	renderString(st, fileLabel, fileX, textY, GRAY_90);
 	renderString(st, saveLabel, saveX, textY, saveColor);
 	renderString(st, fpsLabel, fpsX, textY, YELLOW);
 }
+
+#if PROFILING
+static void fillRect(EditorState& st, u32 x, u32 y, u32 w, u32 h, u32 color) {
+	const RasterKernels& raster = activeRasterKernels();
+	for (u32 row = y; row < y + h; row++) raster.fillSpan(st.screenBuf.row(row) + x, w, color);
+}
+
+static const u32 PROFILE_PHASE_COLORS[ProfilePhaseCount] = {
+	LIGHT_BLUE, GRAY_60, LIGHT_GREEN, DARK_GREEN, YELLOW, ORANGE,
+	PINK, CYAN, LIME, PURPLE, LIGHT_RED
+};
+
+// Drawn over the text rows it covers after they are rendered, and marks
+// them for upload; hiding it must mark everything dirty to bring the text
+// back.
+void renderProfilerOverlay(EditorState& st) {
+	if (!profilerOverlayVisible()) return;
+
+	const u32 width = 640;
+	const u32 height = (2 + ProfilePhaseCount) * LINE_HEIGHT;
+	const u32 textBottom = st.screenBuf.height > BPAD ? st.screenBuf.height - BPAD : 0;
+	if (st.screenBuf.width < width + LPAD || textBottom < TPAD + height) return;
+	const u32 x = st.screenBuf.width - width - LPAD;
+	const u32 y = TPAD;
+
+	static std::vector<FrameProfile> frames(PROFILE_FRAMES);
+	u32 count = copyProfileFrames(frames.data(), PROFILE_FRAMES);
+	f64 msPerTick = 1000.0 / (f64)SDL_GetPerformanceFrequency();
+
+	fillRect(st, x, y, width, height, GRAY_10);
+	char label[64];
+	f64 newestMs = 0.0;
+	for (u32 p = 0; count && p < ProfilePhaseCount; p++) {
+		if (!isNestedProfilePhase((ProfilePhase)p)) newestMs += (f64)frames[0].ticks[p] * msPerTick;
+	}
+	std::snprintf(label, sizeof(label), "Profile  %u frames  last %.2f ms", count, newestMs);
+	renderString(st, label, x + 8, y, GRAY_90);
+
+	// The newest frame, split by phase.
+	u32 barX = x + 8;
+	const u32 barWidth = width - 16;
+	for (u32 p = 0; count && p < ProfilePhaseCount; p++) {
+		if (isNestedProfilePhase((ProfilePhase)p) || newestMs <= 0.0) continue;
+		u32 w = (u32)((f64)frames[0].ticks[p] * msPerTick / newestMs * barWidth);
+		w = std::min(w, x + 8 + barWidth - barX);
+		fillRect(st, barX, y + LINE_HEIGHT + 4, w, LINE_HEIGHT - 8, PROFILE_PHASE_COLORS[p]);
+		barX += w;
+	}
+
+	f64 p50[ProfilePhaseCount] = {};
+	f64 p99[ProfilePhaseCount] = {};
+	f64 maxP99 = 0.0;
+	std::vector<u64> ticks(count);
+	for (u32 p = 0; count && p < ProfilePhaseCount; p++) {
+		for (u32 i = 0; i < count; i++) ticks[i] = frames[i].ticks[p];
+		std::sort(ticks.begin(), ticks.end());
+		p50[p] = (f64)ticks[count / 2] * msPerTick;
+		p99[p] = (f64)ticks[std::min(count - 1, count * 99 / 100)] * msPerTick;
+		maxP99 = std::max(maxP99, p99[p]);
+	}
+
+	const u32 nameWidth = 180;
+	const u32 rangeWidth = 170;
+	for (u32 p = 0; p < ProfilePhaseCount; p++) {
+		u32 rowY = y + (2 + p) * LINE_HEIGHT;
+		bool nested = isNestedProfilePhase((ProfilePhase)p);
+		renderString(st, PROFILE_PHASE_NAMES[p], x + 8 + (nested ? 16 : 0), rowY, PROFILE_PHASE_COLORS[p]);
+		if (maxP99 > 0.0) {
+			u32 p99Width = (u32)(p99[p] / maxP99 * rangeWidth);
+			u32 p50Width = (u32)(p50[p] / maxP99 * rangeWidth);
+			fillRect(st, x + 8 + nameWidth, rowY + 6, p99Width, LINE_HEIGHT - 12, GRAY_30);
+			fillRect(st, x + 8 + nameWidth, rowY + 6, p50Width, LINE_HEIGHT - 12, PROFILE_PHASE_COLORS[p]);
+		}
+		std::snprintf(label, sizeof(label), "p50 %.2f  p99 %.2f", p50[p], p99[p]);
+		renderString(st, label, x + 16 + nameWidth + rangeWidth, rowY, GRAY_80);
+	}
+
+	for (u32 row = 0; row < st.damage.rows.size() && rowBand(row).top < y + height; row++) st.damage.rows[row] = 1;
+}
+#endif
@@ -1,21 +1,48 @@
 #pragma once
+#include <vector>
+
 #include "config.h"
 #include "color.h"
+#include "profiler.h"
+
+// Full-width band of screen rows to upload to the texture.
+struct DirtyRect {
+	u32 y, h;
+};
 
 void renderCharacter(EditorState& st, char character, u32 xPos, u32 yPos, u32 color);
 
 void renderNumber(EditorState& st, std::string_view number, u32 xPos, u32 yPos, u32 color);
 
-void renderString(EditorState& st, std::string_view str, u32 xPos, u32 yPos, u32 color);
+u32 renderString(EditorState& st, std::string_view str, u32 xPos, u32 yPos, u32 color);
+
+// Selected line, separators, line numbers, cursor and text for every dirty
+// row, split across st.rasterPool when there is one.
+void renderTextRows(EditorState& st);
+
+void renderBottom(EditorState& st, f32 frameMs);
+
+// Per-phase frame timings over the top right of the text, while toggled on.
+#if PROFILING
+void renderProfilerOverlay(EditorState& st);
+#else
+inline void renderProfilerOverlay(EditorState&) {}
+#endif
+
+void resizeOffscreenBuffer(OffscreenBuffer& buf, u32 width, u32 height);
+
+void freeOffscreenBuffer(OffscreenBuffer& buf);
+
+void markLineDirty(EditorState& st, u32 line);
 
-void renderLineNumbers(EditorState& st);
+void markLinesDirtyFrom(EditorState& st, u32 line);
 
-void renderLineSeparators(EditorState& st);
+void markAllDirty(EditorState& st);
 
-void renderTextBuffer(EditorState& st);
+void beginFrame(EditorState& st);
 
-void renderSelectedLine(EditorState& st);
+void collectDirtyRects(EditorState& st, std::vector<DirtyRect>& rects);
 
-void renderSelectedPosition(EditorState& st, u32 color);
+bool hasDamage(const EditorState& st);
 
-void renderBottom(EditorState& st, u32 fps);
+void endFrame(EditorState& st);
@@ -0,0 +1,342 @@
+#include <algorithm>
+#include <climits>
+
+#include "search.h"
+#include "config.h"
+#include "eventHandlers.h"
+#include "rasterPool.h"
+
+// Longest run of mapped lines scanned as one block for a literal.
+constexpr u32 SEARCH_RUN_LINES = 4096;
+
+static bool before(const SearchMatch& m, u32 line, u32 column) {
+	return m.line < line || (m.line == line && m.column < column);
+}
+
+// First match that does not start before (line, column).
+static std::vector<SearchMatch>::iterator lowerMatch(std::vector<SearchMatch>& matches, u32 line, u32 column) {
+	return std::lower_bound(matches.begin(), matches.end(), 0, [&](const SearchMatch& m, int) {
+		return before(m, line, column);
+	});
+}
+
+static void matchLine(const SearchPattern& pattern, std::string_view text, u32 line, std::vector<SearchMatch>& out) {
+	u32 from = 0, start, length;
+	while (findInLine(pattern, text, from, start, length)) {
+		out.push_back({ line, start, length });
+		from = start + length;
+	}
+}
+
+// Appends the matches on lines [line, endLine) starting from lb and returns
+// the first line not scanned, stopping early once `budget` runs out; what was
+// read is taken off it. Literals scan runs of lines that still sit back to
+// back in the mapping as one block; a needle has no newline, so hits never
+// straddle two.
+static LineBuffer* scanLines(const SearchPattern& pattern, std::string& scratch, LineBuffer* lb, u32& line, u32 endLine, u64& budget, std::vector<SearchMatch>& out) {
+	std::vector<size_t> starts;
+
+	while (lb && line < endLine && budget > 0) {
+		if (pattern.kind == SearchLiteral && lb->isBorrowed()) {
+			const char* runBegin = lb->text;
+			const char* runEnd = runBegin;
+			u32 runLine = line;
+			starts.clear();
+			do {
+				starts.push_back((size_t)(lb->text - runBegin));
+				runEnd = lb->text + lb->size;
+				lb = lb->next;
+				line++;
+			} while (lb && line < endLine && lb->isBorrowed() && lb->text == runEnd + 1 &&
+			         starts.size() < SEARCH_RUN_LINES && (u64)(runEnd - runBegin) < budget);
+
+			u32 length = (u32)pattern.literal.size();
+			for (const char* pos = runBegin; const char* hit = findLiteral(pattern, pos, runEnd); pos = hit + length) {
+				size_t offset = (size_t)(hit - runBegin);
+				size_t index = (size_t)(std::upper_bound(starts.begin(), starts.end(), offset) - starts.begin()) - 1;
+				out.push_back({ runLine + (u32)index, (u32)(offset - starts[index]), length });
+			}
+			budget -= std::min<u64>(budget, (u64)(runEnd - runBegin) + 1);
+		}
+		else {
+			matchLine(pattern, lb->joined(scratch), line, out);
+			budget -= std::min<u64>(budget, (u64)lb->size + 1);
+			lb = lb->next;
+			line++;
+		}
+	}
+	return lb;
+}
+
+static void refreshStaleLines(EditorState& st) {
+	SearchState& search = st.Search;
+	if (search.staleLines.empty()) return;
+
+	std::sort(search.staleLines.begin(), search.staleLines.end());
+	search.staleLines.erase(std::unique(search.staleLines.begin(), search.staleLines.end()), search.staleLines.end());
+
+	std::vector<SearchMatch> fresh;
+	for (u32 line : search.staleLines) {
+		if (line >= search.scanLine || line >= st.Text->size) continue;
+		fresh.clear();
+		matchLine(search.pattern, st.Text->getLineBuffer(line)->joined(search.scratch), line, fresh);
+
+		auto first = lowerMatch(search.matches, line, 0);
+		auto last = lowerMatch(search.matches, line + 1, 0);
+		first = search.matches.erase(first, last);
+		search.matches.insert(first, fresh.begin(), fresh.end());
+	}
+	search.staleLines.clear();
+	search.revision++;
+}
+
+// Settles the pending n / N jump once the index can answer it: forward as
+// soon as a match at or past the target is indexed, backward once the scan
+// has passed the target line. With nothing on that side it wraps, which
+// takes the whole file. A cursor moved since the request drops it.
+static void resolvePendingJump(EditorState& st) {
+	SearchState& search = st.Search;
+	PendingJump& jump = search.pendingJump;
+	if (!jump.active) return;
+	if (st.CurrLine != jump.cursorLine || st.CursorPos != jump.cursorPos) {
+		jump.active = false;
+		return;
+	}
+
+	bool complete = !search.scanning;
+	auto it = lowerMatch(search.matches, jump.line, jump.column);
+	if (jump.forward) {
+		if (it == search.matches.end()) {
+			if (!complete) return;
+			it = search.matches.begin();
+		}
+	}
+	else {
+		if (!complete && jump.line >= search.scanLine) return;
+		if (it == search.matches.begin()) {
+			if (!complete) {
+				jump.line = UINT32_MAX;
+				return;
+			}
+			it = search.matches.end();
+		}
+		if (it != search.matches.begin()) --it;
+	}
+
+	jump.active = false;
+	if (it == search.matches.end()) return;
+	moveCursorTo(st, it->line, it->column);
+}
+
+// Forward to the first match at or after (line, column), backward to the
+// last one before it; done at once if the index covers it, else by
+// pumpSearch as the scan gets there, so the UI never scans ahead itself.
+static void requestJump(EditorState& st, bool forward, u32 line, u32 column) {
+	SearchState& search = st.Search;
+	search.pendingJump = { true, forward, line, column, st.CurrLine, st.CursorPos };
+	resolvePendingJump(st);
+}
+
+// Moves to the first match after where the search started, once the scan
+// has passed it. With `wrap`, falls back to the first match in the file.
+static void jumpToFirstMatch(EditorState& st, bool wrap) {
+	SearchState& search = st.Search;
+	auto it = lowerMatch(search.matches, search.originLine, search.originPos + 1);
+	if (it == search.matches.end()) {
+		if (!wrap || search.matches.empty()) return;
+		it = search.matches.begin();
+	}
+	moveCursorTo(st, it->line, it->column);
+	search.jumped = true;
+}
+
+void beginSearch(EditorState& st) {
+	SearchState& search = st.Search;
+	search.originLine = st.CurrLine;
+	search.originPos = st.CursorPos;
+	setSearchQuery(st, "");
+}
+
+void setSearchQuery(EditorState& st, const std::string& query) {
+	SearchState& search = st.Search;
+	search.query = query;
+	search.valid = !query.empty() && compileSearchPattern(search.pattern, query) == OK;
+	search.matches.clear();
+	search.staleLines.clear();
+	search.scanLine = 0;
+	search.scanCursor = nullptr;
+	search.scanning = search.valid;
+	search.jumped = false;
+	search.pendingJump.active = false;
+	search.revision++;
+	search.highlightRevision++;
+
+	moveCursorTo(st, search.originLine, search.originPos);
+	if (!search.valid || st.Text->size == 0) return;
+
+	// The screen is matched before anything else, so typing shows the next
+	// match in view without waiting for the scan to reach it.
+	std::vector<SearchMatch> visible;
+	u32 line = std::min(st.TopLine, st.Text->size - 1);
+	u32 endLine = std::min(st.BottomLine + 1, st.Text->size);
+	u64 budget = UINT64_MAX;
+	scanLines(search.pattern, search.scratch, st.Text->getLineBuffer(line), line, endLine, budget, visible);
+	for (const SearchMatch& m : visible) {
+		if (before(m, search.originLine, search.originPos + 1)) continue;
+		moveCursorTo(st, m.line, m.column);
+		search.jumped = true;
+		break;
+	}
+}
+
+void finishSearch(EditorState& st, bool accept) {
+	SearchState& search = st.Search;
+	if (accept && search.valid) {
+		if (!search.jumped) {
+			requestJump(st, true, search.originLine, search.originPos + 1);
+			search.jumped = true;
+		}
+		return;
+	}
+
+	moveCursorTo(st, search.originLine, search.originPos);
+	search.query.clear();
+	search.valid = false;
+	search.scanning = false;
+	search.pendingJump.active = false;
+	search.matches.clear();
+	search.staleLines.clear();
+	search.revision++;
+	search.highlightRevision++;
+}
+
+s16 searchNext(EditorState& st, bool forward) {
+	SearchState& search = st.Search;
+	if (!search.valid || st.Text->size == 0) return ERR_EOF;
+	refreshStaleLines(st);
+
+	if (!search.scanning && search.matches.empty()) return ERR_EOF;
+	requestJump(st, forward, st.CurrLine, forward ? st.CursorPos + 1 : st.CursorPos);
+	return OK;
+}
+
+struct SearchTask {
+	const SearchPattern* pattern;
+	LineBuffer* lb;
+	u32 line, endLine;
+	u64 bytes = 0;
+	std::vector<SearchMatch> matches;
+	std::string scratch;
+};
+
+static void runSearchTask(void* ctx, u32 index) {
+	SearchTask& task = ((SearchTask*)ctx)[index];
+	u64 budget = UINT64_MAX;
+	task.lb = scanLines(*task.pattern, task.scratch, task.lb, task.line, task.endLine, budget, task.matches);
+	task.bytes = UINT64_MAX - budget;
+}
+
+// Splits the next stretch of unscanned lines into one range per pool
+// participant. Workers only read lines while the UI thread waits in
+// runRasterTasks, and ranges are appended in order, so the index stays
+// sorted. Ranges are sized from the average line length of the last slice
+// to come out near SEARCH_SLICE_BYTES each.
+static void scanSlice(EditorState& st) {
+	SearchState& search = st.Search;
+	TextBuffer* text = st.Text;
+	u32 participants = st.rasterPool ? (u32)st.rasterPool->workers.size() + 1 : 1;
+	u64 taskLines = std::max<u64>(1, SEARCH_SLICE_BYTES / search.bytesPerLine);
+
+	std::vector<SearchTask> tasks;
+	u32 line = search.scanLine;
+	for (u32 i = 0; i < participants && line < text->size; i++) {
+		u32 endLine = (u32)std::min<u64>(line + taskLines, text->size);
+		LineBuffer* lb = i == 0 && search.scanCursor ? search.scanCursor : text->getLineBuffer(line);
+		tasks.push_back({ &search.pattern, lb, line, endLine, 0, {}, {} });
+		line = endLine;
+	}
+	if (tasks.size() > 1) runRasterTasks(*st.rasterPool, (u32)tasks.size(), runSearchTask, tasks.data());
+	else runSearchTask(tasks.data(), 0);
+
+	u64 bytes = 0;
+	for (const SearchTask& task : tasks) {
+		search.matches.insert(search.matches.end(), task.matches.begin(), task.matches.end());
+		bytes += task.bytes;
+	}
+	search.bytesPerLine = std::max<u64>(1, bytes / (line - search.scanLine));
+	search.scanLine = line;
+	search.scanCursor = tasks.back().lb;
+}
+
+void pumpSearch(EditorState& st) {
+	SearchState& search = st.Search;
+	if (!search.valid) return;
+	refreshStaleLines(st);
+	if (!search.scanning) return;
+
+	if (search.scanLine < st.Text->size) {
+		scanSlice(st);
+		search.revision++;
+	}
+	if (search.scanLine >= st.Text->size && !st.pendingLoad) {
+		search.scanning = false;
+		search.revision++;
+	}
+
+	if (st.CurrMode == SearchMode && !search.jumped) jumpToFirstMatch(st, !search.scanning);
+	resolvePendingJump(st);
+}
+
+void lineMatches(EditorState& st, u32 line, const LineBuffer* lb, std::vector<SearchMatch>& out) {
+	SearchState& search = st.Search;
+	if (!search.valid) return;
+	if (line >= search.scanLine || std::find(search.staleLines.begin(), search.staleLines.end(), line) != search.staleLines.end()) {
+		matchLine(search.pattern, lb->joined(search.scratch), line, out);
+		return;
+	}
+	auto first = lowerMatch(search.matches, line, 0);
+	auto last = lowerMatch(search.matches, line + 1, 0);
+	out.insert(out.end(), first, last);
+}
+
+u32 currentMatchNumber(EditorState& st) {
+	SearchState& search = st.Search;
+	if (!search.valid || st.CurrLine >= search.scanLine || !search.staleLines.empty()) return 0;
+	auto it = lowerMatch(search.matches, st.CurrLine, st.CursorPos);
+	if (it == search.matches.end() || it->line != st.CurrLine || it->column != st.CursorPos) return 0;
+	return (u32)(it - search.matches.begin()) + 1;
+}
+
+bool searchPending(const EditorState& st) {
+	const SearchState& search = st.Search;
+	return search.valid && (search.scanning || !search.staleLines.empty());
+}
+
+void searchLinesReplaced(EditorState& st, u32 line, u32 removed, u32 inserted) {
+	SearchState& search = st.Search;
+	if (!search.valid) return;
+	s64 delta = (s64)inserted - (s64)removed;
+	u32 endOld = line + removed;
+
+	// Matches on the replaced lines go; the ones below move with their lines.
+	auto first = search.matches.erase(lowerMatch(search.matches, line, 0), lowerMatch(search.matches, endOld, 0));
+	if (delta != 0) {
+		for (auto it = first; it != search.matches.end(); ++it) it->line = (u32)(it->line + delta);
+	}
+
+	std::erase_if(search.staleLines, [&](u32 stale) { return stale >= line && stale < endOld; });
+	for (u32& stale : search.staleLines) {
+		if (stale >= endOld) stale = (u32)(stale + delta);
+	}
+
+	if (search.scanLine >= endOld) search.scanLine = (u32)(search.scanLine + delta);
+	else if (search.scanLine > line) search.scanLine = line;
+	for (u32 i = 0; i < inserted && line + i < search.scanLine; i++) search.staleLines.push_back(line + i);
+
+	search.scanCursor = nullptr;
+	search.pendingJump.active = false;
+	// Edits inside the indexed part only leave stale lines, which the next
+	// pump refreshes without reopening the scan.
+	if ((s64)search.scanLine < (s64)st.Text->size + delta) search.scanning = true;
+	search.revision++;
+}
@@ -0,0 +1,86 @@
+#pragma once
+#include <string>
+#include <vector>
+
+#include "commonTypes.h"
+#include "searchPattern.h"
+
+struct EditorState;
+struct LineBuffer;
+
+struct SearchMatch {
+	u32 line;
+	u32 column;
+	u32 length;
+};
+
+// An n / N (or accepted search) whose match the index cannot settle yet.
+// It is dropped if the cursor leaves (cursorLine, cursorPos) meanwhile.
+struct PendingJump {
+	bool active = false;
+	bool forward = true;
+	u32 line = 0;
+	u32 column = 0;
+	u32 cursorLine = 0;
+	u32 cursorPos = 0;
+};
+
+// The current pattern and every match found for it so far. matches is
+// sorted and complete for lines [0, scanLine); pumpSearch extends it a
+// slice at a time between frames, split across the raster pool. Edits patch
+// the index instead of restarting it: changed lines are queued in
+// staleLines and rescanned.
+struct SearchState {
+	std::string query;
+	SearchPattern pattern;
+	bool valid = false;
+
+	// Where the cursor was when the pattern was typed; it jumps to the first
+	// match after this point as soon as one is found.
+	u32 originLine = 0;
+	u32 originPos = 0;
+	bool jumped = false;
+	PendingJump pendingJump;
+
+	std::vector<SearchMatch> matches;
+	std::vector<u32> staleLines;
+	u32 scanLine = 0;
+	LineBuffer* scanCursor = nullptr;
+	bool scanning = false;
+
+	// Average over the last slice, used to size the next one.
+	u64 bytesPerLine = 64;
+
+	// revision is bumped whenever the query or matches change, so frames
+	// can tell; highlightRevision only when highlights on screen may have
+	// changed without the text changing.
+	u64 revision = 0;
+	u64 highlightRevision = 0;
+	std::string scratch;
+};
+
+void beginSearch(EditorState& st);
+
+// Recompiles the pattern, finds matches on screen right away and leaves
+// the rest of the file to pumpSearch.
+void setSearchQuery(EditorState& st, const std::string& query);
+
+void finishSearch(EditorState& st, bool accept);
+
+// n / N: moves to the next or previous match, wrapping around the file. If
+// the index has not got that far, pumpSearch makes the move when it does.
+s16 searchNext(EditorState& st, bool forward);
+
+void pumpSearch(EditorState& st);
+
+bool searchPending(const EditorState& st);
+
+// Appends the matches on one line for highlighting: from the index where it
+// is current, matched on the spot where the scan has not got to yet.
+void lineMatches(EditorState& st, u32 line, const LineBuffer* lb, std::vector<SearchMatch>& out);
+
+// k in "match k of N" when the cursor sits on an indexed match, else 0.
+u32 currentMatchNumber(EditorState& st);
+
+// Lines [line, line + removed) are about to be replaced by `inserted` lines.
+void searchLinesReplaced(EditorState& st, u32 line, u32 removed, u32 inserted);
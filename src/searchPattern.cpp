@@ -0,0 +1,610 @@
+#include "searchPattern.h"
+#include "cpuFeatures.h"
+
+#include <algorithm>
+#include <bitset>
+#include <cstring>
+#include <iterator>
+#include <map>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#include <immintrin.h>
+#define SEARCH_X86 1
+#elif defined(__aarch64__)
+#include <arm_neon.h>
+#define SEARCH_NEON 1
+#endif
+
+constexpr u32 NFA_NONE = UINT32_MAX;
+constexpr u32 DFA_MAX_STATES = 4096;
+
+// Rough order of how common bytes are in code and logs, most common first.
+static const char COMMON_BYTES[] = " etaoinsrhldcumfpgwybvkxjqz_0123456789.,;:()=\"'/-\t{}[]<>";
+
+static u32 byteRank(u8 c) {
+	const char* found = (const char*)std::memchr(COMMON_BYTES, c, sizeof(COMMON_BYTES) - 1);
+	if (found) return 256 - (u32)(found - COMMON_BYTES);
+	if (c >= 'A' && c <= 'Z') return 150;
+	return 0;
+}
+
+static void pickRareBytes(SearchPattern& pattern) {
+	const std::string& lit = pattern.literal;
+	u32 first = 0;
+	for (u32 i = 1; i < lit.size(); i++) {
+		if (byteRank((u8)lit[i]) < byteRank((u8)lit[first])) first = i;
+	}
+	u32 second = first;
+	for (u32 i = 0; i < lit.size(); i++) {
+		if (i == first) continue;
+		if (second == first || byteRank((u8)lit[i]) < byteRank((u8)lit[second])) second = i;
+	}
+	pattern.rareIndex[0] = first;
+	pattern.rareIndex[1] = second;
+}
+
+static const char* findLiteralScalar(const SearchPattern& pattern, const char* begin, const char* end) {
+	const char* needle = pattern.literal.data();
+	size_t len = pattern.literal.size();
+	if ((size_t)(end - begin) < len) return nullptr;
+
+	u32 rare = pattern.rareIndex[0];
+	const char* candidate = begin + rare;
+	const char* last = end - len + rare;
+	while (candidate <= last) {
+		const char* hit = (const char*)std::memchr(candidate, needle[rare], (size_t)(last - candidate) + 1);
+		if (!hit) return nullptr;
+		if (std::memcmp(hit - rare, needle, len) == 0) return hit - rare;
+		candidate = hit + 1;
+	}
+	return nullptr;
+}
+
+// The vector kernels compare a block of candidate starts against both rare
+// bytes at once and only verify starts where both line up. Loads stay
+// inside [begin, end): the last block is left to the scalar scan.
+#if defined(SEARCH_X86)
+static const char* findLiteralSSE2(const SearchPattern& pattern, const char* begin, const char* end) {
+	const char* needle = pattern.literal.data();
+	size_t len = pattern.literal.size();
+	size_t size = (size_t)(end - begin);
+	if (size < len) return nullptr;
+
+	u32 r0 = pattern.rareIndex[0], r1 = pattern.rareIndex[1];
+	const __m128i b0 = _mm_set1_epi8(needle[r0]);
+	const __m128i b1 = _mm_set1_epi8(needle[r1]);
+	size_t starts = size - len + 1;
+	size_t s = 0;
+	for (; s + 16 <= starts; s += 16) {
+		__m128i c0 = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)(begin + s + r0)), b0);
+		__m128i c1 = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)(begin + s + r1)), b1);
+		u32 mask = (u32)_mm_movemask_epi8(_mm_and_si128(c0, c1));
+		while (mask) {
+			const char* candidate = begin + s + __builtin_ctz(mask);
+			if (std::memcmp(candidate, needle, len) == 0) return candidate;
+			mask &= mask - 1;
+		}
+	}
+	return findLiteralScalar(pattern, begin + s, end);
+}
+
+__attribute__((target("avx2")))
+static const char* findLiteralAVX2(const SearchPattern& pattern, const char* begin, const char* end) {
+	const char* needle = pattern.literal.data();
+	size_t len = pattern.literal.size();
+	size_t size = (size_t)(end - begin);
+	if (size < len) return nullptr;
+
+	u32 r0 = pattern.rareIndex[0], r1 = pattern.rareIndex[1];
+	const __m256i b0 = _mm256_set1_epi8(needle[r0]);
+	const __m256i b1 = _mm256_set1_epi8(needle[r1]);
+	size_t starts = size - len + 1;
+	size_t s = 0;
+	for (; s + 32 <= starts; s += 32) {
+		__m256i c0 = _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i*)(begin + s + r0)), b0);
+		__m256i c1 = _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i*)(begin + s + r1)), b1);
+		u32 mask = (u32)_mm256_movemask_epi8(_mm256_and_si256(c0, c1));
+		while (mask) {
+			const char* candidate = begin + s + __builtin_ctz(mask);
+			if (std::memcmp(candidate, needle, len) == 0) {
+				_mm256_zeroupper();
+				return candidate;
+			}
+			mask &= mask - 1;
+		}
+	}
+	_mm256_zeroupper();
+	return findLiteralScalar(pattern, begin + s, end);
+}
+#endif
+
+#if defined(SEARCH_NEON)
+static const char* findLiteralNEON(const SearchPattern& pattern, const char* begin, const char* end) {
+	const char* needle = pattern.literal.data();
+	size_t len = pattern.literal.size();
+	size_t size = (size_t)(end - begin);
+	if (size < len) return nullptr;
+
+	u32 r0 = pattern.rareIndex[0], r1 = pattern.rareIndex[1];
+	const uint8x16_t b0 = vdupq_n_u8((u8)needle[r0]);
+	const uint8x16_t b1 = vdupq_n_u8((u8)needle[r1]);
+	size_t starts = size - len + 1;
+	size_t s = 0;
+	for (; s + 16 <= starts; s += 16) {
+		uint8x16_t c0 = vceqq_u8(vld1q_u8((const u8*)(begin + s + r0)), b0);
+		uint8x16_t c1 = vceqq_u8(vld1q_u8((const u8*)(begin + s + r1)), b1);
+		// Narrowing shift leaves four mask bits per byte.
+		uint8x8_t narrow = vshrn_n_u16(vreinterpretq_u16_u8(vandq_u8(c0, c1)), 4);
+		u64 mask = vget_lane_u64(vreinterpret_u64_u8(narrow), 0);
+		while (mask) {
+			u32 bit = (u32)__builtin_ctzll(mask) >> 2;
+			const char* candidate = begin + s + bit;
+			if (std::memcmp(candidate, needle, len) == 0) return candidate;
+			mask &= ~(0xFull << (bit * 4));
+		}
+	}
+	return findLiteralScalar(pattern, begin + s, end);
+}
+#endif
+
+typedef const char* (*FindLiteralFn)(const SearchPattern&, const char*, const char*);
+
+static FindLiteralFn selectFindLiteral() {
+	const CpuFeatures& cpu = getCpuFeatures();
+#if defined(SEARCH_X86)
+	if (cpu.avx2) return findLiteralAVX2;
+	if (cpu.sse2) return findLiteralSSE2;
+#elif defined(SEARCH_NEON)
+	if (cpu.neon) return findLiteralNEON;
+#endif
+	(void)cpu;
+	return findLiteralScalar;
+}
+
+const char* findLiteral(const SearchPattern& pattern, const char* begin, const char* end) {
+	static const FindLiteralFn find = selectFindLiteral();
+	return find(pattern, begin, end);
+}
+
+enum NfaKind : u8 {
+	NfaByte, NfaSplit, NfaEmpty, NfaBol, NfaEol, NfaMatch
+};
+
+struct NfaState {
+	NfaKind kind;
+	u32 out = NFA_NONE;
+	u32 out1 = NFA_NONE;
+	u32 set = 0;
+};
+
+// A partly built piece of the NFA: its entry state and the dangling exits
+// (state * 2 + which out) still to be connected.
+struct NfaFragment {
+	u32 start;
+	std::vector<u32> exits;
+};
+
+struct RegexParser {
+	std::string_view text;
+	size_t pos = 0;
+	bool failed = false;
+	std::vector<NfaState> states;
+	std::vector<std::bitset<256>> sets;
+
+	u32 addState(NfaKind kind, u32 set = 0) {
+		NfaState state{};
+		state.kind = kind;
+		state.set = set;
+		states.push_back(state);
+		return (u32)states.size() - 1;
+	}
+
+	u32 addSet(const std::bitset<256>& bytes) {
+		sets.push_back(bytes);
+		return (u32)sets.size() - 1;
+	}
+
+	void patch(const std::vector<u32>& exits, u32 target) {
+		for (u32 exit : exits) {
+			NfaState& state = states[exit >> 1];
+			if (exit & 1) state.out1 = target;
+			else state.out = target;
+		}
+	}
+
+	NfaFragment single(NfaKind kind, u32 set = 0) {
+		u32 s = addState(kind, set);
+		return { s, { s * 2 } };
+	}
+
+	bool atEnd() const { return pos >= text.size(); }
+	char peek() const { return text[pos]; }
+
+	NfaFragment parseAlternation() {
+		NfaFragment left = parseConcat();
+		while (!failed && !atEnd() && peek() == '|') {
+			pos++;
+			NfaFragment right = parseConcat();
+			u32 split = addState(NfaSplit);
+			states[split].out = left.start;
+			states[split].out1 = right.start;
+			left.start = split;
+			left.exits.insert(left.exits.end(), right.exits.begin(), right.exits.end());
+		}
+		return left;
+	}
+
+	NfaFragment parseConcat() {
+		NfaFragment result = single(NfaEmpty);
+		bool empty = true;
+		while (!failed && !atEnd() && peek() != '|' && peek() != ')') {
+			NfaFragment next = parseRepeat();
+			if (failed) break;
+			if (empty) result = next;
+			else {
+				patch(result.exits, next.start);
+				result.exits = std::move(next.exits);
+			}
+			empty = false;
+		}
+		return result;
+	}
+
+	NfaFragment parseRepeat() {
+		NfaFragment atom = parseAtom();
+		while (!failed && !atEnd() && (peek() == '*' || peek() == '+' || peek() == '?')) {
+			char op = text[pos++];
+			u32 split = addState(NfaSplit);
+			states[split].out = atom.start;
+			if (op == '*') {
+				patch(atom.exits, split);
+				atom = { split, { split * 2 + 1 } };
+			}
+			else if (op == '+') {
+				patch(atom.exits, split);
+				atom.exits = { split * 2 + 1 };
+			}
+			else {
+				atom.start = split;
+				atom.exits.push_back(split * 2 + 1);
+			}
+		}
+		return atom;
+	}
+
+	static void addEscapeClass(char c, std::bitset<256>& bytes) {
+		std::bitset<256> cls;
+		char lower = (char)(c | 0x20);
+		for (u32 b = 0; b < 256; b++) {
+			bool in = false;
+			if (lower == 'd') in = b >= '0' && b <= '9';
+			else if (lower == 'w') in = (b >= '0' && b <= '9') || (b >= 'a' && b <= 'z') || (b >= 'A' && b <= 'Z') || b == '_';
+			else if (lower == 's') in = b == ' ' || b == '\t' || b == '\r' || b == '\f' || b == '\v';
+			cls[b] = in;
+		}
+		if (c != lower) cls.flip();
+		cls[(u8)'\n'] = false;
+		bytes |= cls;
+	}
+
+	static bool isClassEscape(char c) {
+		return c == 'd' || c == 'w' || c == 's' || c == 'D' || c == 'W' || c == 'S';
+	}
+
+	NfaFragment parseClass() {
+		std::bitset<256> bytes;
+		bool negate = !atEnd() && peek() == '^';
+		if (negate) pos++;
+
+		bool first = true;
+		while (!atEnd() && (peek() != ']' || first)) {
+			first = false;
+			u8 lo = (u8)text[pos++];
+			if (lo == '\\') {
+				if (atEnd()) { failed = true; break; }
+				char esc = text[pos++];
+				if (isClassEscape(esc)) {
+					addEscapeClass(esc, bytes);
+					continue;
+				}
+				lo = (u8)esc;
+			}
+			u8 hi = lo;
+			if (pos + 1 < text.size() && peek() == '-' && text[pos + 1] != ']') {
+				pos++;
+				hi = (u8)text[pos++];
+				if (hi == '\\') {
+					if (atEnd()) { failed = true; break; }
+					hi = (u8)text[pos++];
+				}
+				if (hi < lo) { failed = true; break; }
+			}
+			for (u32 b = lo; b <= hi; b++) bytes[b] = true;
+		}
+		if (atEnd()) failed = true;
+		else pos++;
+
+		if (negate) bytes.flip();
+		bytes[(u8)'\n'] = false;
+		return single(NfaByte, addSet(bytes));
+	}
+
+	NfaFragment parseAtom() {
+		if (atEnd()) {
+			failed = true;
+			return single(NfaEmpty);
+		}
+		char c = text[pos++];
+		switch (c) {
+			case '(': {
+				NfaFragment inner = parseAlternation();
+				if (atEnd() || peek() != ')') failed = true;
+				else pos++;
+				return inner;
+			}
+			case '[': return parseClass();
+			case '.': {
+				std::bitset<256> bytes;
+				bytes.set();
+				bytes[(u8)'\n'] = false;
+				return single(NfaByte, addSet(bytes));
+			}
+			case '^': return single(NfaBol);
+			case '$': return single(NfaEol);
+			case '*': case '+': case '?':
+				failed = true;
+				return single(NfaEmpty);
+			case '\\': {
+				if (atEnd()) {
+					failed = true;
+					return single(NfaEmpty);
+				}
+				char esc = text[pos++];
+				std::bitset<256> bytes;
+				if (isClassEscape(esc)) addEscapeClass(esc, bytes);
+				else bytes[(u8)esc] = true;
+				return single(NfaByte, addSet(bytes));
+			}
+			default: {
+				std::bitset<256> bytes;
+				bytes[(u8)c] = true;
+				return single(NfaByte, addSet(bytes));
+			}
+		}
+	}
+};
+
+struct DfaBuilder {
+	const RegexParser& nfa;
+	u32 start;
+	std::vector<u32> stack;
+	std::vector<u32> seen;
+	u32 epoch = 0;
+
+	DfaBuilder(const RegexParser& nfa, u32 start) : nfa(nfa), start(start), seen(nfa.states.size(), 0) {}
+
+	// Follows empty edges from `roots`. Kept states are the ones that wait
+	// for input: bytes, end-of-line assertions and the match state. ^ only
+	// passes at the start of a line.
+	void closure(const std::vector<u32>& roots, bool atLineStart, std::vector<u32>& out) {
+		epoch++;
+		out.clear();
+		stack.assign(roots.begin(), roots.end());
+		while (!stack.empty()) {
+			u32 s = stack.back();
+			stack.pop_back();
+			if (s == NFA_NONE || seen[s] == epoch) continue;
+			seen[s] = epoch;
+			const NfaState& state = nfa.states[s];
+			switch (state.kind) {
+				case NfaSplit:
+					stack.push_back(state.out1);
+					stack.push_back(state.out);
+					break;
+				case NfaEmpty: stack.push_back(state.out); break;
+				case NfaBol: if (atLineStart) stack.push_back(state.out); break;
+				default: out.push_back(s); break;
+			}
+		}
+		std::sort(out.begin(), out.end());
+	}
+
+	bool matchesAtEnd(const std::vector<u32>& set) {
+		epoch++;
+		stack.clear();
+		for (u32 s : set) {
+			if (nfa.states[s].kind == NfaMatch) return true;
+			if (nfa.states[s].kind == NfaEol) stack.push_back(nfa.states[s].out);
+		}
+		while (!stack.empty()) {
+			u32 s = stack.back();
+			stack.pop_back();
+			if (s == NFA_NONE || seen[s] == epoch) continue;
+			seen[s] = epoch;
+			const NfaState& state = nfa.states[s];
+			if (state.kind == NfaMatch) return true;
+			if (state.kind == NfaSplit) {
+				stack.push_back(state.out);
+				stack.push_back(state.out1);
+			}
+			else if (state.kind == NfaEmpty || state.kind == NfaEol) stack.push_back(state.out);
+		}
+		return false;
+	}
+};
+
+static void computeByteClasses(const RegexParser& nfa, SearchPattern& pattern) {
+	u32 classes[256] = {};
+	u32 count = 1;
+	for (const std::bitset<256>& set : nfa.sets) {
+		// Splits every class into the bytes inside and outside the set.
+		u32 remap[2][256];
+		std::memset(remap, 0xFF, sizeof(remap));
+		u32 next = 0;
+		for (u32 b = 0; b < 256; b++) {
+			u32& slot = remap[set[b] ? 1 : 0][classes[b]];
+			if (slot == UINT32_MAX) slot = next++;
+			classes[b] = slot;
+		}
+		count = next;
+	}
+	for (u32 b = 0; b < 256; b++) pattern.byteClass[b] = (u8)classes[b];
+	pattern.classCount = count;
+}
+
+static s16 buildDfa(const RegexParser& nfa, u32 start, SearchPattern& pattern) {
+	computeByteClasses(nfa, pattern);
+	u32 classCount = pattern.classCount;
+	u8 representative[256];
+	for (u32 b = 256; b > 0; b--) representative[pattern.byteClass[b - 1]] = (u8)(b - 1);
+
+	DfaBuilder builder(nfa, start);
+	std::vector<u32> midStart;
+	builder.closure({ start }, false, midStart);
+
+	// A DFA state is its NFA set plus whether the start state is re-added
+	// after every byte; unanchored keys carry a trailing NFA_NONE.
+	std::map<std::vector<u32>, u32> ids;
+	std::vector<std::vector<u32>> sets;
+	std::vector<bool> unanchoredSets;
+	pattern.next.assign(classCount, 0);
+	pattern.accepts.assign(1, 0);
+	sets.push_back({});
+	unanchoredSets.push_back(false);
+
+	auto intern = [&](std::vector<u32> set, bool unanchored) -> u32 {
+		if (unanchored) {
+			std::vector<u32> merged;
+			std::set_union(set.begin(), set.end(), midStart.begin(), midStart.end(), std::back_inserter(merged));
+			set = std::move(merged);
+		}
+		if (set.empty()) return 0;
+		std::vector<u32> key = set;
+		if (unanchored) key.push_back(NFA_NONE);
+		auto found = ids.find(key);
+		if (found != ids.end()) return found->second;
+
+		u32 id = (u32)sets.size();
+		ids.emplace(std::move(key), id);
+		u8 accept = 0;
+		for (u32 s : set) if (nfa.states[s].kind == NfaMatch) accept |= 1;
+		if (builder.matchesAtEnd(set)) accept |= 2;
+		pattern.accepts.push_back(accept);
+		pattern.next.resize(pattern.next.size() + classCount, 0);
+		sets.push_back(std::move(set));
+		unanchoredSets.push_back(unanchored);
+		return id;
+	};
+
+	std::vector<u32> bolStart;
+	builder.closure({ start }, true, bolStart);
+	pattern.anchoredStart[0] = intern(midStart, false);
+	pattern.anchoredStart[1] = intern(bolStart, false);
+	pattern.unanchoredStart[0] = intern(midStart, true);
+	pattern.unanchoredStart[1] = intern(bolStart, true);
+
+	std::vector<u32> moved, closed;
+	for (u32 id = 1; id < sets.size(); id++) {
+		if (sets.size() > DFA_MAX_STATES) return ERR_UNSUPPORTED;
+		bool unanchored = unanchoredSets[id];
+		for (u32 cls = 0; cls < classCount; cls++) {
+			u8 byte = representative[cls];
+			moved.clear();
+			for (u32 s : sets[id]) {
+				const NfaState& state = nfa.states[s];
+				if (state.kind == NfaByte && nfa.sets[state.set][byte]) moved.push_back(state.out);
+			}
+			builder.closure(moved, false, closed);
+			u32 target = intern(closed, unanchored);
+			pattern.next[(size_t)id * classCount + cls] = target;
+		}
+	}
+	return OK;
+}
+
+static bool isRegex(std::string_view text) {
+	return text.find_first_of(".[]()*+?|^$\\") != std::string_view::npos;
+}
+
+s16 compileSearchPattern(SearchPattern& pattern, std::string_view text) {
+	pattern = SearchPattern{};
+	if (text.empty() || text.find('\n') != std::string_view::npos) return ERR_UNSUPPORTED;
+
+	if (!isRegex(text)) {
+		pattern.kind = SearchLiteral;
+		pattern.literal = std::string(text);
+		pickRareBytes(pattern);
+		for (u32 b = 0; b < 256; b++) pattern.firstByte[b] = (u8)text[0] == b;
+		return OK;
+	}
+
+	RegexParser parser{};
+	parser.text = text;
+	NfaFragment root = parser.parseAlternation();
+	if (parser.failed || !parser.atEnd()) return ERR_UNSUPPORTED;
+	u32 match = parser.addState(NfaMatch);
+	parser.patch(root.exits, match);
+
+	pattern.kind = SearchRegex;
+	if (buildDfa(parser, root.start, pattern) != OK) return ERR_UNSUPPORTED;
+
+	bool anyFirst = false;
+	for (u32 b = 0; b < 256; b++) {
+		u32 cls = pattern.byteClass[b];
+		bool first = pattern.next[(size_t)pattern.anchoredStart[0] * pattern.classCount + cls] != 0 ||
+		             pattern.next[(size_t)pattern.anchoredStart[1] * pattern.classCount + cls] != 0;
+		pattern.firstByte[b] = first;
+		anyFirst |= first;
+	}
+	return anyFirst ? OK : ERR_UNSUPPORTED;
+}
+
+static bool lineMayMatch(const SearchPattern& pattern, std::string_view line) {
+	u32 classCount = pattern.classCount;
+	u32 state = pattern.unanchoredStart[1];
+	for (char c : line) {
+		state = pattern.next[(size_t)state * classCount + pattern.byteClass[(u8)c]];
+		if (pattern.accepts[state] & 1) return true;
+	}
+	return (pattern.accepts[state] & 2) != 0;
+}
+
+// Longest non-empty match anchored at `start`, or 0.
+static u32 matchAt(const SearchPattern& pattern, std::string_view line, u32 start) {
+	u32 classCount = pattern.classCount;
+	u32 state = pattern.anchoredStart[start == 0 ? 1 : 0];
+	u32 best = 0;
+	u32 i = start;
+	for (; i < line.size(); i++) {
+		state = pattern.next[(size_t)state * classCount + pattern.byteClass[(u8)line[i]]];
+		if (state == 0) return best;
+		if (pattern.accepts[state] & 1) best = i + 1 - start;
+	}
+	if (i > start && (pattern.accepts[state] & 2)) best = i - start;
+	return best;
+}
+
+bool findInLine(const SearchPattern& pattern, std::string_view line, u32 from, u32& start, u32& length) {
+	if (from >= line.size()) return false;
+
+	if (pattern.kind == SearchLiteral) {
+		const char* hit = findLiteral(pattern, line.data() + from, line.data() + line.size());
+		if (!hit) return false;
+		start = (u32)(hit - line.data());
+		length = (u32)pattern.literal.size();
+		return true;
+	}
+
+	// The unanchored pass rejects most lines in one linear scan; only lines
+	// that do match try each possible start.
+	if (!lineMayMatch(pattern, line)) return false;
+	for (u32 s = from; s < line.size(); s++) {
+		if (!pattern.firstByte[(u8)line[s]]) continue;
+		u32 len = matchAt(pattern, line, s);
+		if (len == 0) continue;
+		start = s;
+		length = len;
+		return true;
+	}
+	return false;
+}
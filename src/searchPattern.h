@@ -0,0 +1,46 @@
+#pragma once
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "commonTypes.h"
+
+enum SearchKind : u8 {
+	SearchLiteral = 0, SearchRegex = 1
+};
+
+// A search pattern compiled for scanning one line at a time; matches never
+// span a newline. Patterns without regex metacharacters stay literals and
+// are found with a SIMD scan for two of their rarest bytes. Anything else
+// is compiled to a DFA over byte classes.
+//
+// Regex syntax: . [] [^] a-z ranges, * + ?, |, ( ), ^ $ and the escapes
+// \d \w \s \D \W \S; any other escaped byte is literal.
+struct SearchPattern {
+	SearchKind kind = SearchLiteral;
+	std::string literal;
+	u32 rareIndex[2] = { 0, 0 };
+
+	// next[state * classCount + byteClass[b]]; state 0 is dead.
+	std::vector<u32> next;
+	std::vector<u8> accepts;
+	u8 byteClass[256] = {};
+	u32 classCount = 0;
+	// [0] mid-line, [1] at the start of a line. The unanchored starts keep
+	// the pattern's start state alive at every byte.
+	u32 anchoredStart[2] = { 0, 0 };
+	u32 unanchoredStart[2] = { 0, 0 };
+	// Bytes a match can start with.
+	bool firstByte[256] = {};
+};
+
+// Returns ERR_UNSUPPORTED for malformed patterns, patterns that only match
+// the empty string, and ones whose DFA would be too large.
+s16 compileSearchPattern(SearchPattern& pattern, std::string_view text);
+
+// Leftmost literal match in [begin, end), or nullptr.
+const char* findLiteral(const SearchPattern& pattern, const char* begin, const char* end);
+
+// Leftmost, then longest, non-empty match in line starting at or after
+// `from`.
+bool findInLine(const SearchPattern& pattern, std::string_view line, u32 from, u32& start, u32& length);
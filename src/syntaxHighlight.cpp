@@ -0,0 +1,605 @@
+#include "syntaxHighlight.h"
+#include "config.h"
+#include "render.h"
+#include "traceExport.h"
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+// Both sorted for binary_search.
+static const std::string_view CPP_KEYWORDS[] = {
+	"alignas", "alignof", "asm", "break", "case", "catch", "class", "co_await", "co_return", "co_yield",
+	"const", "consteval", "constexpr", "constinit", "continue", "decltype", "default", "delete", "do",
+	"dynamic_cast", "else", "enum", "explicit", "export", "extern", "false", "final", "for", "friend",
+	"goto", "if", "inline", "mutable", "namespace", "new", "noexcept", "nullptr", "operator", "override",
+	"private", "protected", "public", "register", "reinterpret_cast", "requires", "return", "sizeof",
+	"static", "static_assert", "static_cast", "struct", "switch", "template", "this", "thread_local",
+	"throw", "true", "try", "typedef", "typeid", "typename", "union", "using", "virtual", "volatile", "while",
+};
+
+static const std::string_view CPP_TYPES[] = {
+	"auto", "bool", "char", "char16_t", "char32_t", "char8_t", "double", "f32", "f64", "float",
+	"int", "int16_t", "int32_t", "int64_t", "int8_t", "long", "ptrdiff_t", "s16", "s32", "s64", "s8",
+	"short", "signed", "size_t", "u16", "u32", "u64", "u8", "uint16_t", "uint32_t", "uint64_t",
+	"uint8_t", "uintptr_t", "unsigned", "void", "wchar_t",
+};
+
+static bool isIdentStart(char c) {
+	return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_';
+}
+
+static bool isDigit(char c) {
+	return c >= '0' && c <= '9';
+}
+
+static bool isIdentChar(char c) {
+	return isIdentStart(c) || isDigit(c);
+}
+
+// Spans from `first` on belong to the line being lexed; adjacent ones of
+// the same kind are merged.
+static void emit(std::vector<TokenSpan>* spans, size_t first, u32 start, u32 end, TokenKind kind) {
+	if (!spans || end <= start) return;
+	if (spans->size() > first) {
+		TokenSpan& last = spans->back();
+		if (last.kind == kind && last.start + last.length == start) {
+			last.length = end - last.start;
+			return;
+		}
+	}
+	spans->push_back({ start, end - start, kind });
+}
+
+// Index just past the closing quote, or the line size when the literal runs
+// off the end; `continued` is set when a backslash carries it to the next
+// line.
+static u32 scanQuoted(std::string_view line, u32 i, char quote, bool& continued) {
+	u32 n = (u32)line.size();
+	continued = false;
+	while (i < n) {
+		char c = line[i];
+		if (c == '\\') {
+			if (i + 1 == n) {
+				continued = true;
+				return n;
+			}
+			i += 2;
+			continue;
+		}
+		i++;
+		if (c == quote) return i;
+	}
+	return n;
+}
+
+// Raw strings end at the first )" since the delimiter is not carried
+// between lines.
+static u32 scanRaw(std::string_view line, u32 i, bool& closed) {
+	size_t end = line.find(")\"", i);
+	closed = end != std::string_view::npos;
+	return closed ? (u32)end + 2 : (u32)line.size();
+}
+
+static bool isRawPrefix(std::string_view ident) {
+	return ident == "R" || ident == "LR" || ident == "uR" || ident == "UR" || ident == "u8R";
+}
+
+static bool isStringPrefix(std::string_view ident) {
+	return ident == "L" || ident == "u" || ident == "U" || ident == "u8";
+}
+
+LexState lexCppLine(std::string_view line, LexState state, std::vector<TokenSpan>* spans) {
+	u32 n = (u32)line.size();
+	u32 i = 0;
+	bool continued = false;
+	size_t first = spans ? spans->size() : 0;
+
+	switch (state) {
+		case LexBlockComment: {
+			size_t close = line.find("*/");
+			if (close == std::string_view::npos) {
+				emit(spans, first, 0, n, TokenComment);
+				return LexBlockComment;
+			}
+			i = (u32)close + 2;
+			emit(spans, first, 0, i, TokenComment);
+		} break;
+		case LexString:
+		case LexChar: {
+			i = scanQuoted(line, 0, state == LexString ? '"' : '\'', continued);
+			emit(spans, first, 0, i, TokenString);
+			if (continued) return state;
+		} break;
+		case LexLineComment: {
+			emit(spans, first, 0, n, TokenComment);
+			return n > 0 && line[n - 1] == '\\' ? LexLineComment : LexNormal;
+		}
+		case LexRawString: {
+			bool closed;
+			i = scanRaw(line, 0, closed);
+			emit(spans, first, 0, i, TokenString);
+			if (!closed) return LexRawString;
+		} break;
+		case LexNormal: break;
+	}
+
+	u32 firstNonSpace = 0;
+	while (firstNonSpace < n && (line[firstNonSpace] == ' ' || line[firstNonSpace] == '\t')) firstNonSpace++;
+
+	while (i < n) {
+		char c = line[i];
+		char next = i + 1 < n ? line[i + 1] : '\0';
+
+		if (c == '/' && next == '/') {
+			emit(spans, first, i, n, TokenComment);
+			return line[n - 1] == '\\' ? LexLineComment : LexNormal;
+		}
+		if (c == '/' && next == '*') {
+			size_t close = line.find("*/", i + 2);
+			if (close == std::string_view::npos) {
+				emit(spans, first, i, n, TokenComment);
+				return LexBlockComment;
+			}
+			emit(spans, first, i, (u32)close + 2, TokenComment);
+			i = (u32)close + 2;
+			continue;
+		}
+		if (c == '"' || c == '\'') {
+			u32 end = scanQuoted(line, i + 1, c, continued);
+			emit(spans, first, i, end, TokenString);
+			if (continued) return c == '"' ? LexString : LexChar;
+			i = end;
+			continue;
+		}
+		if (c == '#' && i == firstNonSpace) {
+			u32 end = i + 1;
+			while (end < n && (line[end] == ' ' || line[end] == '\t')) end++;
+			u32 wordStart = end;
+			while (end < n && isIdentChar(line[end])) end++;
+			emit(spans, first, i, end, TokenPreprocessor);
+			std::string_view directive = line.substr(wordStart, end - wordStart);
+			i = end;
+
+			if (directive == "include") {
+				while (i < n && (line[i] == ' ' || line[i] == '\t')) i++;
+				if (i < n && line[i] == '<') {
+					size_t close = line.find('>', i);
+					u32 headerEnd = close == std::string_view::npos ? n : (u32)close + 1;
+					emit(spans, first, i, headerEnd, TokenString);
+					i = headerEnd;
+				}
+			}
+			continue;
+		}
+		if (isDigit(c) || (c == '.' && isDigit(next))) {
+			// Covers hex, binary, suffixes, exponents and ' separators.
+			u32 end = i + 1;
+			while (end < n) {
+				char d = line[end];
+				if (isIdentChar(d) || d == '.' || d == '\'') end++;
+				else if ((d == '+' || d == '-') && (line[end - 1] == 'e' || line[end - 1] == 'E' || line[end - 1] == 'p' || line[end - 1] == 'P')) end++;
+				else break;
+			}
+			emit(spans, first, i, end, TokenNumber);
+			i = end;
+			continue;
+		}
+		if (isIdentStart(c)) {
+			u32 end = i + 1;
+			while (end < n && isIdentChar(line[end])) end++;
+			std::string_view ident = line.substr(i, end - i);
+
+			if (end < n && line[end] == '"' && isRawPrefix(ident)) {
+				bool closed;
+				u32 stringEnd = scanRaw(line, end + 1, closed);
+				emit(spans, first, i, stringEnd, TokenString);
+				if (!closed) return LexRawString;
+				i = stringEnd;
+				continue;
+			}
+			if (end < n && (line[end] == '"' || line[end] == '\'') && isStringPrefix(ident)) {
+				char quote = line[end];
+				u32 stringEnd = scanQuoted(line, end + 1, quote, continued);
+				emit(spans, first, i, stringEnd, TokenString);
+				if (continued) return quote == '"' ? LexString : LexChar;
+				i = stringEnd;
+				continue;
+			}
+
+			if (std::binary_search(std::begin(CPP_KEYWORDS), std::end(CPP_KEYWORDS), ident)) emit(spans, first, i, end, TokenKeyword);
+			else if (std::binary_search(std::begin(CPP_TYPES), std::end(CPP_TYPES), ident)) emit(spans, first, i, end, TokenType);
+			i = end;
+			continue;
+		}
+		i++;
+	}
+	return LexNormal;
+}
+
+static bool isCppFileName(const std::string& fileName) {
+	size_t dot = fileName.find_last_of('.');
+	if (dot == std::string::npos) return false;
+	std::string_view ext = std::string_view(fileName).substr(dot + 1);
+	static const std::string_view CPP_EXTENSIONS[] = { "c", "cc", "cpp", "cxx", "h", "hh", "hpp", "hxx", "inl", "ipp" };
+	return std::find(std::begin(CPP_EXTENSIONS), std::end(CPP_EXTENSIONS), ext) != std::end(CPP_EXTENSIONS);
+}
+
+// A chained job starts where the previous prefix job left off.
+struct LexJob {
+	bool viewport;
+	bool chained;
+	u64 generation;
+	u32 firstLine;
+	u32 lineCount;
+	LexState state;
+	TextSnapshot snapshot;
+};
+
+struct LexResult {
+	bool viewport;
+	u64 generation;
+	u32 firstLine;
+	LexState state;
+	std::vector<u8> endStates;
+};
+
+// queue is a heap that yields the viewport job first, then prefix jobs from
+// the top of the file down.
+struct HighlightWorker {
+	std::thread worker;
+	std::mutex lock;
+	std::condition_variable wake;
+	std::condition_variable idle;
+	std::vector<LexJob> queue;
+	std::vector<LexResult> results;
+	bool busy = false;
+	bool stopping = false;
+	std::atomic<u64> generation{0};
+};
+
+static bool lexesAfter(const LexJob& a, const LexJob& b) {
+	if (a.viewport != b.viewport) return !a.viewport;
+	return a.firstLine > b.firstLine;
+}
+
+// Where each prefix job ends, so a chained one can pick up from it.
+struct LexCarry {
+	u64 generation = UINT64_MAX;
+	u32 line = 0;
+	LexState state = LexNormal;
+};
+
+static bool runLexJob(HighlightWorker* worker, const LexJob& job, LexCarry& carry, LexResult& result) {
+	LexState state = job.state;
+	if (job.chained) {
+		if (carry.generation != job.generation || carry.line != job.firstLine) return false;
+		state = carry.state;
+	}
+	result = { job.viewport, job.generation, job.firstLine, state, {} };
+	result.endStates.reserve(job.lineCount);
+	SnapshotCursor cursor;
+	seekSnapshotLine(cursor, job.snapshot, job.firstLine);
+	for (u32 i = 0; i < job.lineCount; i++) {
+		if ((i & 4095) == 0 && worker->generation.load(std::memory_order_relaxed) != job.generation) return false;
+		state = lexCppLine(nextSnapshotLine(cursor), state, nullptr);
+		result.endStates.push_back(state);
+	}
+	if (!job.viewport) carry = { job.generation, job.firstLine + job.lineCount, state };
+	return true;
+}
+
+static void runHighlightWorker(HighlightWorker* worker) {
+	TRACE_THREAD_NAME("highlight");
+	LexCarry carry;
+	std::unique_lock<std::mutex> guard(worker->lock);
+	while (true) {
+		worker->wake.wait(guard, [worker]() { return worker->stopping || !worker->queue.empty(); });
+		if (worker->stopping) break;
+		std::pop_heap(worker->queue.begin(), worker->queue.end(), lexesAfter);
+		LexJob job = worker->queue.back();
+		worker->queue.pop_back();
+		worker->busy = true;
+		guard.unlock();
+
+		LexResult result;
+		bool finished;
+		{
+			TRACE_SCOPE("lexJob");
+			finished = runLexJob(worker, job, carry, result);
+			releaseSnapshot(job.snapshot);
+		}
+
+		guard.lock();
+		if (finished) worker->results.push_back(std::move(result));
+		worker->busy = false;
+		worker->idle.notify_all();
+	}
+}
+
+void startHighlightWorker(SyntaxHighlight& syntax) {
+	HighlightWorker* worker = new HighlightWorker{};
+	worker->worker = std::thread(runHighlightWorker, worker);
+	syntax.worker = worker;
+}
+
+void stopHighlightWorker(SyntaxHighlight& syntax) {
+	HighlightWorker* worker = syntax.worker;
+	if (!worker) return;
+	{
+		std::lock_guard<std::mutex> guard(worker->lock);
+		worker->stopping = true;
+	}
+	worker->wake.notify_one();
+	worker->worker.join();
+	for (LexJob& job : worker->queue) releaseSnapshot(job.snapshot);
+	delete worker;
+	syntax.worker = nullptr;
+}
+
+static void invalidateJobs(SyntaxHighlight& syntax) {
+	syntax.generation++;
+	syntax.submittedLines = syntax.lexedLines;
+	syntax.viewportPending = false;
+	HighlightWorker* worker = syntax.worker;
+	if (!worker) return;
+	std::lock_guard<std::mutex> guard(worker->lock);
+	worker->generation.store(syntax.generation, std::memory_order_relaxed);
+	for (LexJob& job : worker->queue) releaseSnapshot(job.snapshot);
+	worker->queue.clear();
+	worker->results.clear();
+}
+
+void cancelHighlightJobs(SyntaxHighlight& syntax) {
+	invalidateJobs(syntax);
+	HighlightWorker* worker = syntax.worker;
+	if (!worker) return;
+	std::unique_lock<std::mutex> guard(worker->lock);
+	worker->idle.wait(guard, [worker]() { return !worker->busy; });
+	worker->results.clear();
+}
+
+void resetSyntaxHighlight(SyntaxHighlight& syntax, const std::string& fileName) {
+	syntax.enabled = isCppFileName(fileName);
+	syntax.endStates.clear();
+	syntax.lexedLines = 0;
+	syntax.staleLines.clear();
+	syntax.guessStates.clear();
+	syntax.guessesStale = false;
+	invalidateJobs(syntax);
+}
+
+static LexState startState(const SyntaxHighlight& syntax, u32 line) {
+	return line == 0 ? LexNormal : (LexState)syntax.endStates[line - 1];
+}
+
+// The state `line` starts in, from the lexed lines or else the guesses.
+static bool knownStartState(const SyntaxHighlight& syntax, u32 line, LexState& state) {
+	if (line <= syntax.lexedLines) {
+		state = startState(syntax, line);
+		return true;
+	}
+	if (line < syntax.guessFirst || line - syntax.guessFirst > syntax.guessStates.size()) return false;
+	state = line == syntax.guessFirst ? syntax.guessStart : (LexState)syntax.guessStates[line - 1 - syntax.guessFirst];
+	return true;
+}
+
+static void spliceGuesses(SyntaxHighlight& syntax, u32 line, u32 removed, u32 inserted) {
+	std::vector<u8>& guesses = syntax.guessStates;
+	u32 guessEnd = syntax.guessFirst + (u32)guesses.size();
+	if (guesses.empty() || line >= guessEnd) return;
+	if (line < syntax.guessFirst) {
+		if (line + removed > syntax.guessFirst) guesses.clear();
+		else syntax.guessFirst = syntax.guessFirst + inserted - removed;
+		return;
+	}
+	u32 at = line - syntax.guessFirst;
+	u32 endOld = std::min<u32>(at + removed, (u32)guesses.size());
+	u8 carried = endOld > at ? guesses[endOld - 1] : at > 0 ? guesses[at - 1] : (u8)syntax.guessStart;
+	guesses.erase(guesses.begin() + at, guesses.begin() + endOld);
+	guesses.insert(guesses.begin() + at, inserted, carried);
+	syntax.guessesStale = true;
+}
+
+void highlightLinesReplaced(EditorState& st, u32 line, u32 removed, u32 inserted) {
+	SyntaxHighlight& syntax = st.Syntax;
+	if (!syntax.enabled) return;
+	s64 delta = (s64)inserted - (s64)removed;
+	u32 endOld = line + removed;
+
+	// Queued jobs hold line numbers and text from before the edit.
+	bool jobsStale = (line < syntax.submittedLines && (delta != 0 || endOld > syntax.lexedLines))
+		|| (syntax.viewportPending && line < syntax.viewportEnd);
+	spliceGuesses(syntax, line, removed, inserted);
+	if (line >= syntax.lexedLines) {
+		if (jobsStale) invalidateJobs(syntax);
+		return;
+	}
+
+	std::erase_if(syntax.staleLines, [&](u32 stale) { return stale >= line && stale < endOld; });
+	for (u32& stale : syntax.staleLines) {
+		if (stale >= endOld) stale = (u32)(stale + delta);
+	}
+
+	if (endOld > syntax.lexedLines) {
+		syntax.lexedLines = line;
+		syntax.endStates.resize(line);
+		invalidateJobs(syntax);
+		return;
+	}
+	// New lines take the end state the replaced ones left, so re-lexing them
+	// stops as soon as they end the same way.
+	u8 carried = removed > 0 ? syntax.endStates[endOld - 1] : (u8)startState(syntax, line);
+	syntax.endStates.erase(syntax.endStates.begin() + line, syntax.endStates.begin() + endOld);
+	syntax.endStates.insert(syntax.endStates.begin() + line, inserted, carried);
+	syntax.lexedLines = (u32)(syntax.lexedLines + delta);
+	if (jobsStale) invalidateJobs(syntax);
+
+	// With lines only removed, the one that moves up into their place starts
+	// in a state that may have changed.
+	u32 count = std::max<u32>(inserted, 1);
+	for (u32 i = 0; i < count && line + i < syntax.lexedLines; i++) syntax.staleLines.push_back(line + i);
+}
+
+static void submitJobs(EditorState& st, u32 endLine) {
+	SyntaxHighlight& syntax = st.Syntax;
+	HighlightWorker* worker = syntax.worker;
+	TextBuffer* text = st.Text;
+	endLine = std::min(endLine, text->size);
+	std::vector<LexJob> jobs;
+
+	u32 first = std::max(st.TopLine, syntax.lexedLines);
+	bool guessed = !syntax.guessesStale && syntax.guessFirst <= first
+		&& syntax.guessFirst + syntax.guessStates.size() >= endLine;
+	bool requested = syntax.viewportPending && syntax.viewportFirst == first && syntax.viewportEnd == endLine;
+	if (first < endLine && !guessed && !requested) {
+		LexState state = LexNormal;
+		knownStartState(syntax, first, state);
+		jobs.push_back({ true, false, syntax.generation, first, endLine - first, state, {} });
+		syntax.viewportFirst = first;
+		syntax.viewportEnd = endLine;
+		syntax.viewportPending = true;
+	}
+
+	u32 target = std::min(text->size, endLine + HIGHLIGHT_CHUNK_LINES);
+	target = std::min(target, syntax.lexedLines + HIGHLIGHT_AHEAD_CHUNKS * HIGHLIGHT_CHUNK_LINES);
+	while (syntax.submittedLines < target) {
+		u32 line = syntax.submittedLines;
+		u32 count = std::min(HIGHLIGHT_CHUNK_LINES, target - line);
+		bool chained = line != syntax.lexedLines;
+		LexState state = chained ? LexNormal : startState(syntax, line);
+		jobs.push_back({ false, chained, syntax.generation, line, count, state, {} });
+		syntax.submittedLines += count;
+	}
+	if (jobs.empty()) return;
+
+	TextSnapshot snapshot = takeSnapshot(*text);
+	for (LexJob& job : jobs) job.snapshot = shareSnapshot(snapshot);
+	releaseSnapshot(snapshot);
+	{
+		std::lock_guard<std::mutex> guard(worker->lock);
+		if (jobs.front().viewport) {
+			for (LexJob& job : worker->queue) {
+				if (job.viewport) releaseSnapshot(job.snapshot);
+			}
+			std::erase_if(worker->queue, [](const LexJob& job) { return job.viewport; });
+			std::make_heap(worker->queue.begin(), worker->queue.end(), lexesAfter);
+		}
+		for (LexJob& job : jobs) {
+			worker->queue.push_back(job);
+			std::push_heap(worker->queue.begin(), worker->queue.end(), lexesAfter);
+		}
+	}
+	worker->wake.notify_one();
+}
+
+static void markLinesOnScreenDirty(EditorState& st, u32 first, u32 end) {
+	first = std::max(first, st.TopLine);
+	end = std::min(end, st.TopLine + st.DisplayedLineCount);
+	for (u32 line = first; line < end; line++) markLineDirty(st, line);
+}
+
+void updateHighlight(EditorState& st, u32 endLine) {
+	SyntaxHighlight& syntax = st.Syntax;
+	if (!syntax.enabled) return;
+	TextBuffer* text = st.Text;
+
+	std::sort(syntax.staleLines.begin(), syntax.staleLines.end());
+	syntax.staleLines.erase(std::unique(syntax.staleLines.begin(), syntax.staleLines.end()), syntax.staleLines.end());
+
+	// Each stale line is re-lexed, then the lines after it for as long as the
+	// state they start in differs from before. With a worker, a ripple that
+	// runs past the budget is cut off there and the rest lexed in the
+	// background.
+	u32 budget = syntax.worker ? HIGHLIGHT_SYNC_LINES : UINT32_MAX;
+	u32 done = 0;
+	for (u32 stale : syntax.staleLines) {
+		if (stale < done || stale >= syntax.lexedLines) continue;
+		u32 line = stale;
+		const LineBuffer* lb = text->getLineBuffer(line);
+		LexState state = startState(syntax, line);
+		bool changed = false;
+		while (line < syntax.lexedLines) {
+			if (budget == 0) {
+				syntax.endStates.resize(line);
+				syntax.lexedLines = line;
+				markLinesDirtyFrom(st, line);
+				break;
+			}
+			budget--;
+			LexState end = lexCppLine(lb->joined(syntax.scratch), state, nullptr);
+			syntax.linesLexed++;
+			changed = end != syntax.endStates[line];
+			syntax.endStates[line] = end;
+			line++;
+			if (!changed) break;
+			markLineDirty(st, line);
+			state = end;
+			lb = lb->next;
+		}
+		// The next queued job starts from the old state of the last line.
+		if (line == syntax.lexedLines && (changed || budget == 0)) invalidateJobs(syntax);
+		done = line;
+	}
+	syntax.staleLines.clear();
+
+	if (syntax.worker) {
+		submitJobs(st, endLine);
+		return;
+	}
+	endLine = std::min(endLine, text->size);
+	if (syntax.lexedLines >= endLine) return;
+	const LineBuffer* lb = text->getLineBuffer(syntax.lexedLines);
+	LexState state = startState(syntax, syntax.lexedLines);
+	for (; syntax.lexedLines < endLine; syntax.lexedLines++, lb = lb->next) {
+		state = lexCppLine(lb->joined(syntax.scratch), state, nullptr);
+		syntax.endStates.push_back(state);
+		syntax.linesLexed++;
+	}
+}
+
+void pumpHighlight(EditorState& st) {
+	SyntaxHighlight& syntax = st.Syntax;
+	HighlightWorker* worker = syntax.worker;
+	if (!worker || !syntax.enabled) return;
+
+	std::vector<LexResult> results;
+	{
+		std::lock_guard<std::mutex> guard(worker->lock);
+		results.swap(worker->results);
+	}
+	for (LexResult& result : results) {
+		if (result.generation != syntax.generation) continue;
+		u32 end = result.firstLine + (u32)result.endStates.size();
+		if (result.viewport) {
+			syntax.guessFirst = result.firstLine;
+			syntax.guessStart = result.state;
+			syntax.guessStates = std::move(result.endStates);
+			syntax.guessesStale = false;
+			syntax.viewportPending = false;
+			markLinesOnScreenDirty(st, result.firstLine, end);
+		}
+		else if (result.firstLine == syntax.lexedLines) {
+			syntax.endStates.insert(syntax.endStates.end(), result.endStates.begin(), result.endStates.end());
+			syntax.lexedLines = end;
+			syntax.linesLexed += result.endStates.size();
+			// Rows drawn from a guess, or not at all, start in a known state now.
+			markLinesOnScreenDirty(st, result.firstLine + 1, end + 1);
+		}
+	}
+	submitJobs(st, st.TopLine + st.DisplayedLineCount);
+}
+
+bool highlightPending(const EditorState& st) {
+	const SyntaxHighlight& syntax = st.Syntax;
+	return syntax.worker && syntax.enabled && (syntax.submittedLines > syntax.lexedLines || syntax.viewportPending);
+}
+
+void lineTokens(EditorState& st, u32 line, const LineBuffer* lb, std::vector<TokenSpan>& out) {
+	SyntaxHighlight& syntax = st.Syntax;
+	LexState state;
+	if (!syntax.enabled || !knownStartState(syntax, line, state)) return;
+	lexCppLine(lb->joined(syntax.scratch), state, &out);
+}
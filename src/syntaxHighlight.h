@@ -0,0 +1,95 @@
+#pragma once
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "commonTypes.h"
+
+struct EditorState;
+struct LineBuffer;
+struct HighlightWorker;
+
+enum TokenKind : u8 {
+	TokenText = 0, TokenKeyword = 1, TokenType = 2, TokenNumber = 3, TokenString = 4, TokenComment = 5, TokenPreprocessor = 6
+};
+
+// What a line leaves open for the next one.
+enum LexState : u8 {
+	LexNormal = 0, LexBlockComment = 1, LexString = 2, LexChar = 3, LexLineComment = 4, LexRawString = 5
+};
+
+// Columns [start, start + length) of one token; plain text is not listed.
+struct TokenSpan {
+	u32 start;
+	u32 length;
+	TokenKind kind;
+};
+
+// Lexes one line of C/C++ starting in `state` and returns the state at its
+// end, appending the line's tokens to spans when given.
+LexState lexCppLine(std::string_view line, LexState state, std::vector<TokenSpan>* spans);
+
+// endStates[i] is the lexer state at the end of line i, valid for lines
+// [0, lexedLines) except those queued in staleLines. Edits queue the lines
+// they touch; updateHighlight re-lexes each one and keeps going only while
+// the end state comes out different from the cached one.
+//
+// With a worker, lexing forward happens off the UI thread on a snapshot of
+// the text taken when the job is queued. Lines on screen past lexedLines are
+// lexed first, from a guessed start state, into guessStates; the rest of
+// the file is only lexed as far as the screen needs. Lines with neither
+// keep the default color until results arrive.
+struct SyntaxHighlight {
+	bool enabled = false;
+	std::vector<u8> endStates;
+	u32 lexedLines = 0;
+	std::vector<u32> staleLines;
+	std::string scratch;
+	// Every line lexed so far, for measuring how far edits ripple.
+	u64 linesLexed = 0;
+
+	// guessStates[i] is the end state of line guessFirst + i when lexing
+	// starts from guessStart at guessFirst.
+	u32 guessFirst = 0;
+	LexState guessStart = LexNormal;
+	std::vector<u8> guessStates;
+	bool guessesStale = false;
+
+	HighlightWorker* worker = nullptr;
+	// Bumped whenever queued jobs stop matching the text; their results are
+	// dropped.
+	u64 generation = 0;
+	// Lines [lexedLines, submittedLines) are queued or being lexed.
+	u32 submittedLines = 0;
+	u32 viewportFirst = 0;
+	u32 viewportEnd = 0;
+	bool viewportPending = false;
+};
+
+// Turns highlighting on for C/C++ file names and drops cached states.
+void resetSyntaxHighlight(SyntaxHighlight& syntax, const std::string& fileName);
+
+void startHighlightWorker(SyntaxHighlight& syntax);
+
+void stopHighlightWorker(SyntaxHighlight& syntax);
+
+// Drops queued jobs and waits for the one in progress, so the text they
+// were taken from can be freed.
+void cancelHighlightJobs(SyntaxHighlight& syntax);
+
+// Lines [line, line + removed) are about to be replaced by `inserted` lines.
+void highlightLinesReplaced(EditorState& st, u32 line, u32 removed, u32 inserted);
+
+// Re-lexes stale lines, then makes sure lines [0, endLine) get lexed:
+// right away without a worker, by queuing jobs with one. Rows whose start
+// state changed are marked dirty.
+void updateHighlight(EditorState& st, u32 endLine);
+
+// Takes in the worker's results and queues more work for the screen.
+void pumpHighlight(EditorState& st);
+
+bool highlightPending(const EditorState& st);
+
+// Appends the tokens of `line` for drawing; nothing when highlighting is
+// off or the state the line starts in is not known yet.
+void lineTokens(EditorState& st, u32 line, const LineBuffer* lb, std::vector<TokenSpan>& out);
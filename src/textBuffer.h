@@ -1,239 +1,499 @@
 #pragma once
 #include <algorithm>
+#include <cstring>
+#include <string>
 #include <string_view>
+#include <vector>
 
 #include "commonTypes.h"
+#include "arena.h"
 #include "diagnostics.h"
-
+#include "mappedFile.h"
+#include "textSnapshot.h"
+
+// Every line construction and content edit draws a fresh value, so
+// (address, version) names one exact line text even after the pool hands
+// the address to a different line.
+inline u64 nextLineVersion() {
+	static u64 counter = 0;
+	return ++counter;
+}
+
+// An owned line is a gap buffer: text[0, gapStart) and
+// text[gapEnd, capacity) hold the characters, the gap between them is free
+// space that follows the cursor, so typing and backspacing at the cursor
+// are O(1) amortized. With capacity == 0 the line instead borrows its text
+// straight from the mapped file; borrowed text is read-only and the first
+// edit copies it into an owned buffer.
 struct LineBuffer {
 	u32 size = 0;
 	u32 capacity;
+	u32 gapStart = 0;
+	u32 gapEnd = 0;
+	u64 version = nextLineVersion();
 	char* text;
+	TextArena* arena;
 	LineBuffer* next = nullptr;
 	LineBuffer* prev = nullptr;
 
-	LineBuffer(u32 capacity) {
+	LineBuffer(TextArena* arena, u32 capacity) {
+		this->arena = arena;
+		text = arena->allocate(capacity);
 		this->capacity = capacity;
-		text = new char[capacity];
+		gapEnd = capacity;
+	}
+
+	LineBuffer(TextArena* arena, const char* borrowed, u32 size) {
+		this->arena = arena;
+		this->size = size;
+		capacity = 0;
+		gapStart = gapEnd = size;
+		text = const_cast<char*>(borrowed);
 	}
 
-	char operator[](u32 index) {
+	~LineBuffer() {
+		if (capacity) arena->deallocate(text, capacity);
+	}
+
+	char operator[](u32 index) const {
 		DIAG_ASSERT(index < size, "LineBuffer[] index out of bounds");
-		return text[index];
+		return index < gapStart ? text[index] : text[index + gapEnd - gapStart];
+	}
+
+	char at(u32 index) const {
+		if (index < gapStart) return text[index];
+		return index < size ? text[index + gapEnd - gapStart] : '\0';
+	}
+
+	// The characters before and after the gap, in order.
+	std::string_view head() const { return std::string_view(text, gapStart); }
+	std::string_view tail() const { return std::string_view(text + gapEnd, size - gapStart); }
+
+	// Whole line as one span; closes the gap by moving it to the end.
+	std::string_view view() {
+		if (!isBorrowed()) moveGap(size);
+		return head();
+	}
+
+	// Whole line as one span without moving the gap; the halves are copied
+	// into scratch only when both are non-empty.
+	std::string_view joined(std::string& scratch) const {
+		if (gapStart == size) return head();
+		if (gapStart == 0) return tail();
+		scratch.assign(head());
+		scratch.append(tail());
+		return scratch;
+	}
+
+	bool isBorrowed() const { return capacity == 0; }
+
+	void detach() {
+		if (!isBorrowed()) return;
+		u32 newCapacity = std::max<u32>(128, size * 2 + 16);
+		char* owned = arena->allocate(newCapacity);
+		std::copy_n(text, size, owned);
+		text = owned;
+		capacity = newCapacity;
+		gapStart = size;
+		gapEnd = capacity;
 	}
 
 	void append(char c) {
-		if (shouldGrowBuffer()) growBuffer();
-		text[size++] = c;
-		text[size] = '\0';
+		appendAt(c, size);
 	}
 
 	void appendAt(char c, u32 index) {
-		if (shouldGrowBuffer()) growBuffer();
-
 		DIAG_ASSERT(index <= size, "appendAt index out of bounds");
-		if (index == size) {
-			append(c);
-			return;
-		}
+		detach();
+		if (shouldGrowBuffer()) growBuffer();
 
-		for (u32 i = size; i > index; i--) {
-			text[i] = text[i-1];
-		}
-		text[index] = c;
+		moveGap(index);
+		text[gapStart++] = c;
 		size++;
+		version = nextLineVersion();
+	}
+
+	void insertText(u32 index, std::string_view str) {
+		DIAG_ASSERT(index <= size, "insertText index out of bounds");
+		if (str.empty()) return;
+		detach();
+		while (gapEnd - gapStart < str.size()) growBuffer();
+
+		moveGap(index);
+		std::copy_n(str.data(), str.size(), text + gapStart);
+		gapStart += (u32)str.size();
+		size += (u32)str.size();
+		version = nextLineVersion();
+	}
+
+	void ensureCapacity(u32 required) {
+		detach();
+		while (required > capacity) growBuffer();
+	}
+
+	// Moves [index, size) into nextLine, replacing whatever it held.
+	void splitAt(u32 index, LineBuffer* nextLine) {
+		DIAG_ASSERT(nextLine != nullptr, "splitAt missing destination");
+		if (index > size) index = size;
+
+		u32 len = size - index;
+		if (!isBorrowed()) moveGap(index);
+		const char* rest = isBorrowed() ? text + index : text + gapEnd;
+
+		nextLine->clear();
+		nextLine->ensureCapacity(len);
+		std::copy_n(rest, len, nextLine->text);
+		nextLine->gapStart = len;
+		nextLine->size = len;
+		nextLine->version = nextLineVersion();
+
+		size = index;
+		if (isBorrowed()) gapStart = gapEnd = size;
+		else gapEnd = capacity;
+		version = nextLineVersion();
 	}
 
-    void ensureCapacity(u32 required) {
-        while (required > capacity) growBuffer();
-    }
-
-    void splitAt(u32 index, LineBuffer* nextLine) {
-        DIAG_ASSERT(nextLine != nullptr, "splitAt missing destination");
-        if (index > size) index = size;
-
-        u32 len = size - index;
-        nextLine->ensureCapacity(len + 1);
-        if (len > 0) {
-            std::copy_n(text + index, len, nextLine->text);
-        }
-        nextLine->size = len;
-        nextLine->text[len] = '\0';
-
-        size = index;
-        text[size] = '\0';
-        if (len > 0) {
-            std::memset(text + index, 0, len);
-        }
-    }
-	
 	void remove() {
 		if (size == 0) return;
-		text[--size] = 0;
-		text[size] = '\0';
+		removeAt(size - 1);
 	}
 
 	void removeAt(u32 index) {
 		if (size == 0) return;
 
 		DIAG_ASSERT(index < size, "removeAt index out of bounds");
-		if (index == size - 1) {
-			remove();
-			return;
-		}
-		for (u32 i = index; i < size - 1; i++) {
-			text[i] = text[i+1];
-		}
-		text[--size] = 0;
+		detach();
+		moveGap(index + 1);
+		gapStart--;
+		size--;
+		version = nextLineVersion();
 	}
 
-	void clear() { std::memset(text, 0, size); }
+	void removeRange(u32 index, u32 len) {
+		DIAG_ASSERT(index + len <= size, "removeRange out of bounds");
+		if (len == 0) return;
+		detach();
+		moveGap(index + len);
+		gapStart -= len;
+		size -= len;
+		version = nextLineVersion();
+	}
+
+	void clear() {
+		detach();
+		size = 0;
+		gapStart = 0;
+		gapEnd = capacity;
+		version = nextLineVersion();
+	}
 
 	bool shouldGrowBuffer() {
-		return (size + 8 >= capacity);
-		
+		return gapStart == gapEnd;
 	}
 
 	void growBuffer() {
-		char* other = new char[capacity * 2];
-		std::copy_n(text, capacity, other);
-		delete text;
+		u32 newCapacity = capacity * 2;
+		u32 tailLen = capacity - gapEnd;
+		char* other = arena->allocate(newCapacity);
+		std::copy_n(text, gapStart, other);
+		std::copy_n(text + gapEnd, tailLen, other + newCapacity - tailLen);
+		arena->deallocate(text, capacity);
 		text = other;
-		capacity = capacity * 2;
+		capacity = newCapacity;
+		gapEnd = newCapacity - tailLen;
+	}
+
+	void moveGap(u32 index) {
+		if (index < gapStart) {
+			u32 len = gapStart - index;
+			std::memmove(text + gapEnd - len, text + index, len);
+			gapStart -= len;
+			gapEnd -= len;
+		} else if (index > gapStart) {
+			u32 len = index - gapStart;
+			std::memmove(text + gapStart, text + gapEnd, len);
+			gapStart += len;
+			gapEnd += len;
+		}
 	}
 };
 
+// Implicit treap over the lines, ordered by position and augmented with
+// subtree line counts so indexed lookup, insert and remove are O(log n).
+// LineBuffer keeps its next/prev links so neighbouring lines stay O(1).
+struct LineNode {
+	LineBuffer* line = nullptr;
+	LineNode* left = nullptr;
+	LineNode* right = nullptr;
+	u32 count = 1;
+	u32 priority = 0;
+};
+
 struct TextBuffer {
 	u32 size;
 	LineBuffer* front;
 	LineBuffer* back;
+	LineNode* root;
+	MappedFile mapping{};
+	// Whether the last line is followed by a newline when written out.
+	bool finalNewline = false;
+	Pool<LineBuffer> linePool;
+	Pool<LineNode> nodePool;
+	TextArena textArena;
+	SnapshotStore snapshots;
+	u32 seed = 0x9E3779B9;
 	const u32 DEFAULT_SIZE = 128;
 
 	TextBuffer() {
 		size = 0;
 		front = nullptr;
 		back = nullptr;
+		root = nullptr;
 	}
 
-	TextBuffer(u32 lines) {
-		size = lines;
-		LineBuffer* curr = new LineBuffer(DEFAULT_SIZE);
-		front = curr;
-		for (u32 i = 1; i < lines; i++) {
-			curr->next = new LineBuffer(DEFAULT_SIZE);
-			curr->next->prev = curr;
-			curr = curr->next;
-		}
-		back = curr;
+	TextBuffer(u32 lines) : TextBuffer() {
+		for (u32 i = 0; i < lines; i++) append();
 	};
 
+	// Lines, nodes and text go back chunk by chunk when the pools and the
+	// arena are destroyed; nothing walks the lines one by one.
 	~TextBuffer() {
-		LineBuffer* curr = front;
-		while (curr != back) {
-			curr = curr->next;
-			delete curr->prev;
-		}
-		delete back;
+		unmapFile(mapping);
 	}
 
 	void append(std::string_view text="", u32 textLen=0) {
-		u32 lineSize = textLen;
-		u32 allocationSize = std::max(DEFAULT_SIZE, lineSize + 1);
-		LineBuffer* newLine = new LineBuffer(allocationSize);
+		linkBack(createLine(text, textLen));
+	}
 
-		if (lineSize) {
-			std::copy_n(text.begin(), lineSize, newLine->text);
-		}
-		newLine->size = lineSize;
-		newLine->text[lineSize] = '\0';
+	// Appends a line that points into `mapping` instead of copying it.
+	void appendBorrowed(const char* text, u32 textLen) {
+		linkBack(linePool.create(&textArena, text, textLen));
+	}
 
-		if (!front) {
-			front = back = newLine;
-		} else {
-			newLine->prev = back;
-			back->next = newLine;
-			back = newLine;
+	// Appends one borrowed line per entry of lineEnds, the first starting at
+	// lineStart and each next one just past the previous end. The batch is
+	// built into a treap in O(count) and merged onto the end in O(log n).
+	void appendBorrowedLines(u64 lineStart, const u64* lineEnds, size_t count) {
+		if (count == 0) return;
+		snapshots.borrowedLinesAppended(size, mapping.data, lineStart, lineEnds, (u32)count);
+
+		std::vector<LineNode*> spine;
+		for (size_t i = 0; i < count; i++) {
+			LineBuffer* newLine = linePool.create(&textArena, mapping.data + lineStart, (u32)(lineEnds[i] - lineStart));
+			lineStart = lineEnds[i] + 1;
+			linkList(newLine);
+
+			LineNode* node = createNode(newLine);
+			LineNode* last = nullptr;
+			while (!spine.empty() && spine.back()->priority < node->priority) {
+				last = spine.back();
+				spine.pop_back();
+				update(last);
+			}
+			node->left = last;
+			if (!spine.empty()) spine.back()->right = node;
+			spine.push_back(node);
 		}
-		size += 1;
+		for (size_t i = spine.size(); i > 0; i--) update(spine[i - 1]);
+
+		root = merge(root, spine.front());
+		size += (u32)count;
 	}
 
 	LineBuffer* getLineBuffer(u32 index) {
 		DIAG_ASSERT(index < size, "getLineBuffer index out of bounds");
-		LineBuffer* curr = front;
-		for (u32 i = 0; i < index; i++) {
-			curr = curr->next;
+		LineNode* curr = root;
+		while (true) {
+			u32 leftCount = count(curr->left);
+			if (index < leftCount) curr = curr->left;
+			else if (index == leftCount) return curr->line;
+			else {
+				index -= leftCount + 1;
+				curr = curr->right;
+			}
 		}
-		return curr;
 	}
 
-	s16 insertAtLine(LineBuffer* nextLine, std::string_view text="", u32 textLen=0) {
-		LineBuffer* newLine;
-		if (text != "") {
-			newLine = new LineBuffer(textLen);
-			std::copy_n(text.begin(), textLen, newLine->text);
-		}
-		else {
-			newLine = new LineBuffer(DEFAULT_SIZE);
-		}
+	s16 insertAtIndex(u32 index, std::string_view text="", u32 textLen=0) {
+		DIAG_ASSERT(index <= size, "insertAtIndex out of bounds");
 
-		if (nextLine == nullptr) {
-			newLine->prev = back;
-			back->next = newLine;
-			back = newLine;
-			size++;
-			return OK;
-		}
-		else if (nextLine == front) {
-			newLine->next = front;
-			front->prev = newLine;
-			front = newLine;
-			size++;
+		if (index == size) {
+			append(text, textLen);
 			return OK;
 		}
 
+		LineBuffer* nextLine = getLineBuffer(index);
 		LineBuffer* prevLine = nextLine->prev;
+		LineBuffer* newLine = createLine(text, textLen);
 
 		newLine->next = nextLine;
 		newLine->prev = prevLine;
-		prevLine->next = newLine;
 		nextLine->prev = newLine;
+		if (prevLine) prevLine->next = newLine;
+		else front = newLine;
+
+		LineNode* left;
+		LineNode* right;
+		split(root, index, left, right);
+		root = merge(merge(left, createNode(newLine)), right);
+		snapshots.linesReplaced(index, 0, 1);
 		size++;
 		return OK;
 	}
 
-	s16 insertAtIndex(u32 index) {
-		DIAG_ASSERT(index <= size, "insertAtIndex out of bounds");
+	s16 removeAtIndex(u32 index) {
+		DIAG_ASSERT(index < size, "removeAtIndex out of bounds");
+
+		LineNode* left;
+		LineNode* mid;
+		LineNode* right;
+		split(root, index, left, mid);
+		split(mid, 1, mid, right);
+		root = merge(left, right);
+
+		LineBuffer* line = mid->line;
+		if (line->prev) line->prev->next = line->next;
+		else front = line->next;
+		if (line->next) line->next->prev = line->prev;
+		else back = line->prev;
+
+		linePool.destroy(line);
+		nodePool.destroy(mid);
+		snapshots.linesReplaced(index, 1, 0);
+		size--;
+		return OK;
+	}
 
-		if (index == size) {
-			LineBuffer* newLine = new LineBuffer(DEFAULT_SIZE);
+	// Appends line index + 1 to the end of line index and removes it.
+	s16 joinAtIndex(u32 index) {
+		DIAG_ASSERT(index + 1 < size, "joinAtIndex out of bounds");
+		LineBuffer* lb = getLineBuffer(index);
+		LineBuffer* next = lb->next;
+		lb->insertText(lb->size, next->head());
+		lb->insertText(lb->size, next->tail());
+		snapshots.linesReplaced(index, 1, 1);
+		return removeAtIndex(index + 1);
+	}
+
+	// Inserts text, which may hold newlines, at (line, column); the rest of
+	// the line ends up behind the last inserted one. O(size of text) plus
+	// O(log n) per newline.
+	void insertBlock(u32 line, u32 column, std::string_view text) {
+		LineBuffer* lb = getLineBuffer(line);
+		size_t newline = text.find('\n');
+		if (newline == std::string_view::npos) {
+			lb->insertText(column, text);
+			return;
+		}
+		insertAtIndex(line + 1);
+		lb->splitAt(column, lb->next);
+		lb->insertText(lb->size, text.substr(0, newline));
+
+		u32 index = line + 1;
+		size_t start = newline + 1;
+		while ((newline = text.find('\n', start)) != std::string_view::npos) {
+			insertAtIndex(index++, text.substr(start, newline - start), (u32)(newline - start));
+			start = newline + 1;
+		}
+		getLineBuffer(index)->insertText(0, text.substr(start));
+	}
+
+	// Removes text that insertBlock put at (line, column), given the same
+	// text. Same cost as inserting it.
+	void removeBlock(u32 line, u32 column, std::string_view text) {
+		LineBuffer* lb = getLineBuffer(line);
+		u32 newlines = (u32)std::count(text.begin(), text.end(), '\n');
+		if (newlines == 0) {
+			lb->removeRange(column, (u32)text.size());
+			return;
+		}
+		u32 lastLength = (u32)(text.size() - text.rfind('\n') - 1);
+		lb->removeRange(column, lb->size - column);
+		getLineBuffer(line + newlines)->removeRange(0, lastLength);
+		for (u32 i = 1; i < newlines; i++) removeAtIndex(line + 1);
+		joinAtIndex(line);
+	}
+
+	// Content edits happen on the LineBuffer itself, so whoever makes one
+	// reports it here for the next snapshot.
+	void lineEdited(u32 index) {
+		snapshots.linesReplaced(index, 1, 1);
+	}
+
+private:
+	void linkList(LineBuffer* newLine) {
+		if (!front) {
+			front = back = newLine;
+		} else {
 			newLine->prev = back;
 			back->next = newLine;
 			back = newLine;
-			size++;
-			return OK;
 		}
+	}
 
+	void linkBack(LineBuffer* newLine) {
+		linkList(newLine);
+		root = merge(root, createNode(newLine));
+		snapshots.linesReplaced(size, 0, 1);
+		size += 1;
+	}
 
-		LineBuffer* nextLine = front;
-		for (u32 i = 0; i < index; i++) nextLine = nextLine->next;
-
-		LineBuffer* newLine = new LineBuffer(DEFAULT_SIZE);
+	LineBuffer* createLine(std::string_view text, u32 textLen) {
+		u32 allocationSize = std::max(DEFAULT_SIZE, textLen + 1);
+		LineBuffer* newLine = linePool.create(&textArena, allocationSize);
 
-		if (nextLine == front) {
-			newLine->next = front;
-			front->prev = newLine;
-			front = newLine;
-			size++;
-			return OK;
+		if (textLen) {
+			std::copy_n(text.begin(), textLen, newLine->text);
 		}
+		newLine->size = textLen;
+		newLine->gapStart = textLen;
+		return newLine;
+	}
 
-		LineBuffer* prevLine = nextLine->prev;
+	LineNode* createNode(LineBuffer* line) {
+		// xorshift32, only needs to be cheap and well spread
+		seed ^= seed << 13;
+		seed ^= seed >> 17;
+		seed ^= seed << 5;
 
-		newLine->next = nextLine;
-		newLine->prev = prevLine;
-		prevLine->next = newLine;
-		nextLine->prev = newLine;
-		size++;
-		return OK;
+		LineNode* node = nodePool.create();
+		node->line = line;
+		node->priority = seed;
+		return node;
+	}
+
+	static u32 count(LineNode* node) { return node ? node->count : 0; }
+
+	static void update(LineNode* node) {
+		node->count = 1 + count(node->left) + count(node->right);
+	}
+
+	// Splits the first k lines of node into left, the rest into right.
+	static void split(LineNode* node, u32 k, LineNode*& left, LineNode*& right) {
+		if (!node) {
+			left = right = nullptr;
+			return;
+		}
+		if (count(node->left) < k) {
+			split(node->right, k - count(node->left) - 1, node->right, right);
+			left = node;
+		} else {
+			split(node->left, k, left, node->left);
+			right = node;
+		}
+		update(node);
+	}
+
+	static LineNode* merge(LineNode* left, LineNode* right) {
+		if (!left) return right;
+		if (!right) return left;
+		if (left->priority > right->priority) {
+			left->right = merge(left->right, right);
+			update(left);
+			return left;
+		}
+		right->left = merge(left, right->left);
+		update(right);
+		return right;
 	}
 };
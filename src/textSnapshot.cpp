@@ -0,0 +1,316 @@
+#include "textSnapshot.h"
+#include "textBuffer.h"
+
+static u32 count(const SnapshotNode* node) { return node ? node->count : 0; }
+
+static u32 pending(const SnapshotNode* node) { return node ? node->pending : 0; }
+
+static bool isPending(const SnapshotNode* node) { return !node->data && !node->ends; }
+
+static void update(SnapshotNode* node) {
+	node->count = node->lines + count(node->left) + count(node->right);
+	node->pending = (isPending(node) ? 1 : 0) + pending(node->left) + pending(node->right);
+}
+
+// Line i of the node, which must hold it.
+static std::string_view nodeLine(const SnapshotNode* node, u32 i, const char* mappingData) {
+	if (!node->ends) return std::string_view(node->data, node->size);
+	u64 begin = i == 0 ? node->start : node->ends[i - 1] + 1;
+	return std::string_view(mappingData + begin, (size_t)(node->ends[i] - begin));
+}
+
+static FrozenText* frozenOf(const SnapshotNode* node) {
+	return (FrozenText*)(void*)node->data - 1;
+}
+
+static u32 frozenCapacity(u32 size) {
+	return TextArena::roundUp((u32)sizeof(FrozenText) + size);
+}
+
+static void dropText(SnapshotStore& store, SnapshotNode* node) {
+	if (node->frozen) {
+		FrozenText* text = frozenOf(node);
+		if (--text->refs == 0) store.textArena.deallocate((char*)text, frozenCapacity(text->size));
+	}
+	node->data = nullptr;
+	node->frozen = false;
+}
+
+static void freezeLine(SnapshotStore& store, SnapshotNode* node, const LineBuffer* lb) {
+	node->size = lb->size;
+	if (lb->isBorrowed()) {
+		node->data = lb->text;
+		node->frozen = false;
+		return;
+	}
+	u32 capacity = frozenCapacity(lb->size);
+	FrozenText* text = new (store.textArena.allocate(capacity)) FrozenText{};
+	text->size = lb->size;
+	char* chars = (char*)(text + 1);
+	std::string_view head = lb->head();
+	std::copy(head.begin(), head.end(), chars);
+	std::string_view tail = lb->tail();
+	std::copy(tail.begin(), tail.end(), chars + head.size());
+	node->data = chars;
+	node->frozen = true;
+}
+
+static SnapshotNode* createNode(SnapshotStore& store) {
+	// xorshift32, as in TextBuffer
+	u32& seed = store.seed;
+	seed ^= seed << 13;
+	seed ^= seed >> 17;
+	seed ^= seed << 5;
+
+	SnapshotNode* node = store.nodePool.create();
+	node->priority = seed;
+	node->pending = 1;
+	return node;
+}
+
+// Drops one reference; the last one releases the children too and hands
+// the node to the UI thread. Safe on any thread.
+static void releaseNode(SnapshotStore& store, SnapshotNode* node) {
+	while (node && node->refs.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+		releaseNode(store, node->left);
+		SnapshotNode* right = node->right;
+		node->left = store.garbage.load(std::memory_order_relaxed);
+		while (!store.garbage.compare_exchange_weak(node->left, node, std::memory_order_release, std::memory_order_relaxed)) {}
+		node = right;
+	}
+}
+
+static void freeGarbage(SnapshotStore& store) {
+	SnapshotNode* node = store.garbage.exchange(nullptr, std::memory_order_acquire);
+	while (node) {
+		SnapshotNode* next = node->left;
+		dropText(store, node);
+		store.nodePool.destroy(node);
+		node = next;
+	}
+}
+
+// The node itself when nothing else holds it, else a copy that takes its
+// place in the caller's tree.
+static SnapshotNode* own(SnapshotStore& store, SnapshotNode* node) {
+	if (node->refs.load(std::memory_order_acquire) == 1) return node;
+	SnapshotNode* copy = store.nodePool.create();
+	copy->priority = node->priority;
+	copy->count = node->count;
+	copy->pending = node->pending;
+	copy->lines = node->lines;
+	copy->size = node->size;
+	copy->frozen = node->frozen;
+	copy->left = node->left;
+	copy->right = node->right;
+	copy->data = node->data;
+	copy->ends = node->ends;
+	copy->start = node->start;
+	if (copy->left) copy->left->refs.fetch_add(1, std::memory_order_relaxed);
+	if (copy->right) copy->right->refs.fetch_add(1, std::memory_order_relaxed);
+	if (copy->frozen) frozenOf(copy)->refs++;
+	releaseNode(store, node);
+	return copy;
+}
+
+// Splits the first k lines of node into left, the rest into right. A run
+// with k inside it is cut in two; the second half takes its priority and
+// its right subtree, so heap order holds.
+static void split(SnapshotStore& store, SnapshotNode* node, u32 k, SnapshotNode*& left, SnapshotNode*& right) {
+	if (!node) {
+		left = right = nullptr;
+		return;
+	}
+	node = own(store, node);
+	u32 leftCount = count(node->left);
+	if (k <= leftCount) {
+		split(store, node->left, k, left, node->left);
+		right = node;
+	} else if (k >= leftCount + node->lines) {
+		split(store, node->right, k - leftCount - node->lines, node->right, right);
+		left = node;
+	} else {
+		u32 cut = k - leftCount;
+		SnapshotNode* tail = store.nodePool.create();
+		tail->priority = node->priority;
+		tail->lines = node->lines - cut;
+		tail->ends = node->ends + cut;
+		tail->start = node->ends[cut - 1] + 1;
+		tail->right = node->right;
+		update(tail);
+		node->lines = cut;
+		node->right = nullptr;
+		left = node;
+		right = tail;
+	}
+	update(node);
+}
+
+static SnapshotNode* merge(SnapshotStore& store, SnapshotNode* left, SnapshotNode* right) {
+	if (!left) return right;
+	if (!right) return left;
+	if (left->priority > right->priority) {
+		left = own(store, left);
+		left->right = merge(store, left->right, right);
+		update(left);
+		return left;
+	}
+	right = own(store, right);
+	right->left = merge(store, left, right->left);
+	update(right);
+	return right;
+}
+
+// `count` pending lines built in O(count) on a right spine.
+static SnapshotNode* buildPending(SnapshotStore& store, u32 count) {
+	std::vector<SnapshotNode*> spine;
+	for (u32 i = 0; i < count; i++) {
+		SnapshotNode* node = createNode(store);
+		SnapshotNode* last = nullptr;
+		while (!spine.empty() && spine.back()->priority < node->priority) {
+			last = spine.back();
+			spine.pop_back();
+			update(last);
+		}
+		node->left = last;
+		if (!spine.empty()) spine.back()->right = node;
+		spine.push_back(node);
+	}
+	for (size_t i = spine.size(); i > 0; i--) update(spine[i - 1]);
+	return spine.empty() ? nullptr : spine.front();
+}
+
+static SnapshotNode* buildRun(SnapshotStore& store, const SnapshotEdit& edit) {
+	SnapshotNode* node = createNode(store);
+	node->lines = edit.inserted;
+	node->ends = edit.ends;
+	node->start = edit.start;
+	update(node);
+	return node;
+}
+
+// Walks the buffer's line list alongside an in-order pass over the tree,
+// falling back to an indexed lookup across long stretches with nothing
+// pending.
+struct LineCursor {
+	TextBuffer& text;
+	LineBuffer* line = nullptr;
+	u32 index = 0;
+};
+
+static const LineBuffer* lineAt(LineCursor& cursor, u32 index) {
+	if (!cursor.line || index < cursor.index || index - cursor.index > 64) cursor.line = cursor.text.getLineBuffer(index);
+	else for (u32 i = cursor.index; i < index; i++) cursor.line = cursor.line->next;
+	cursor.index = index;
+	return cursor.line;
+}
+
+// Gives every pending line in the subtree its current text; `first` is the
+// index of the subtree's first line.
+static SnapshotNode* takePending(SnapshotStore& store, LineCursor& cursor, SnapshotNode* node, u32 first) {
+	if (pending(node) == 0) return node;
+	node = own(store, node);
+	node->left = takePending(store, cursor, node->left, first);
+	u32 index = first + count(node->left);
+	if (isPending(node)) freezeLine(store, node, lineAt(cursor, index));
+	node->right = takePending(store, cursor, node->right, index + node->lines);
+	update(node);
+	return node;
+}
+
+// Lines edited in place get a pending node of their own, cut out of
+// whatever run held them.
+void applySnapshotEdits(SnapshotStore& store) {
+	if (store.edits.empty()) return;
+	freeGarbage(store);
+	for (const SnapshotEdit& edit : store.edits) {
+		SnapshotNode* left;
+		SnapshotNode* mid;
+		SnapshotNode* right;
+		split(store, store.root, edit.line, left, mid);
+		split(store, mid, edit.removed, mid, right);
+		releaseNode(store, mid);
+		mid = edit.ends ? buildRun(store, edit) : buildPending(store, edit.inserted);
+		store.root = merge(store, merge(store, left, mid), right);
+	}
+	store.edits.clear();
+	store.version++;
+}
+
+SnapshotStore::~SnapshotStore() {
+	DIAG_ASSERT(liveSnapshots.load() == 0, "TextBuffer destroyed while snapshots of it are alive");
+}
+
+TextSnapshot takeSnapshot(TextBuffer& text) {
+	SnapshotStore& store = text.snapshots;
+	freeGarbage(store);
+	applySnapshotEdits(store);
+	LineCursor cursor{ text };
+	store.root = takePending(store, cursor, store.root, 0);
+	DIAG_ASSERT(count(store.root) == text.size, "snapshot tree out of step with the text");
+	store.size = text.size;
+
+	if (store.root) store.root->refs.fetch_add(1, std::memory_order_relaxed);
+	store.liveSnapshots.fetch_add(1, std::memory_order_relaxed);
+	return { &store, store.root, store.size, store.version };
+}
+
+TextSnapshot shareSnapshot(const TextSnapshot& snapshot) {
+	if (snapshot.root) snapshot.root->refs.fetch_add(1, std::memory_order_relaxed);
+	if (snapshot.store) snapshot.store->liveSnapshots.fetch_add(1, std::memory_order_relaxed);
+	return snapshot;
+}
+
+void releaseSnapshot(TextSnapshot& snapshot) {
+	if (!snapshot.store) return;
+	releaseNode(*snapshot.store, snapshot.root);
+	snapshot.store->liveSnapshots.fetch_sub(1, std::memory_order_release);
+	snapshot = {};
+}
+
+std::string_view snapshotLine(const TextSnapshot& snapshot, u32 index) {
+	DIAG_ASSERT(index < snapshot.size, "snapshotLine index out of bounds");
+	const SnapshotNode* node = snapshot.root;
+	while (true) {
+		u32 leftCount = count(node->left);
+		if (index < leftCount) node = node->left;
+		else if (index < leftCount + node->lines) return nodeLine(node, index - leftCount, snapshot.store->mappingData);
+		else {
+			index -= leftCount + node->lines;
+			node = node->right;
+		}
+	}
+}
+
+void seekSnapshotLine(SnapshotCursor& cursor, const TextSnapshot& snapshot, u32 index) {
+	cursor.stack.clear();
+	cursor.offset = 0;
+	cursor.mappingData = snapshot.store ? snapshot.store->mappingData : nullptr;
+	const SnapshotNode* node = snapshot.root;
+	while (node) {
+		u32 leftCount = count(node->left);
+		if (index < leftCount + node->lines) {
+			cursor.stack.push_back(node);
+			if (index < leftCount) {
+				node = node->left;
+				continue;
+			}
+			cursor.offset = index - leftCount;
+			return;
+		}
+		index -= leftCount + node->lines;
+		node = node->right;
+	}
+}
+
+std::string_view nextSnapshotLine(SnapshotCursor& cursor) {
+	DIAG_ASSERT(!cursor.stack.empty(), "nextSnapshotLine past the end");
+	const SnapshotNode* node = cursor.stack.back();
+	std::string_view line = nodeLine(node, cursor.offset++, cursor.mappingData);
+	if (cursor.offset == node->lines) {
+		cursor.stack.pop_back();
+		cursor.offset = 0;
+		for (const SnapshotNode* next = node->right; next; next = next->left) cursor.stack.push_back(next);
+	}
+	return line;
+}
@@ -0,0 +1,151 @@
+#pragma once
+#include <atomic>
+#include <string_view>
+#include <vector>
+
+#include "commonTypes.h"
+#include "arena.h"
+
+struct TextBuffer;
+
+// Text of an edited line as it was when a snapshot was taken, followed by
+// its characters; shared by every node that points at it. Only the UI
+// thread changes refs, since nodes are only copied and freed there.
+struct FrozenText {
+	u32 refs = 1;
+	u32 size = 0;
+};
+
+struct SnapshotStore;
+
+// Node of a persistent treap over the lines of a snapshot. Nodes reachable
+// from a snapshot are never written again: the store copies the path to a
+// shared node before changing it and only edits nodes it alone holds in
+// place. refs counts parents plus snapshots holding the node as root.
+//
+// A node holds `lines` lines. With `ends` set it is a run of lines that are
+// still the file's own: line i of the run ends at ends[i] in the mapping
+// and the first starts at `start`. Otherwise it holds one line: data is null
+// while its text has yet to be taken from the buffer, and points just past
+// a FrozenText when `frozen`, else into the mapping.
+struct SnapshotNode {
+	std::atomic<u32> refs{1};
+	u32 priority = 0;
+	// Lines in the subtree.
+	u32 count = 1;
+	// Lines in the subtree whose data is still null.
+	u32 pending = 0;
+	u32 lines = 1;
+	u32 size = 0;
+	bool frozen = false;
+	// Doubles as the garbage list link once the node is released.
+	SnapshotNode* left = nullptr;
+	SnapshotNode* right = nullptr;
+	const char* data = nullptr;
+	const u64* ends = nullptr;
+	u64 start = 0;
+};
+
+// A line splice in TextBuffer order: [line, line + removed) became
+// `inserted` lines. A line edited in place is (line, 1, 1). With `ends` set
+// the inserted lines are a run loaded from the mapping.
+struct SnapshotEdit {
+	u32 line;
+	u32 removed;
+	u32 inserted;
+	const u64* ends = nullptr;
+	u64 start = 0;
+};
+
+// Edits are applied to the tree once this many are logged, even with no
+// snapshot taken, so the log stays bounded.
+constexpr size_t SNAPSHOT_EDIT_BATCH = 4096;
+
+void applySnapshotEdits(SnapshotStore& store);
+
+// Owned by a TextBuffer and kept alongside its tree from the first line
+// loaded. Lines appended from the mapping cost one run node per batch, so a
+// file that is only read costs a node per load batch, not per line; only
+// lines that are edited get nodes of their own. Edits are logged and
+// applied to the tree when the next snapshot is taken, or every
+// SNAPSHOT_EDIT_BATCH edits, so typing between snapshots costs a push_back.
+// A thread that drops the last reference to a node pushes it onto
+// `garbage`; the UI thread frees it there.
+struct SnapshotStore {
+	SnapshotNode* root = nullptr;
+	u32 size = 0;
+	u64 version = 0;
+	std::vector<SnapshotEdit> edits;
+
+	// Line ends of every run appended from the mapping. The inner arrays
+	// never move, so run nodes point into them.
+	std::vector<std::vector<u64>> runEnds;
+	const char* mappingData = nullptr;
+
+	Pool<SnapshotNode> nodePool;
+	TextArena textArena;
+	std::atomic<SnapshotNode*> garbage{nullptr};
+	std::atomic<u32> liveSnapshots{0};
+	u32 seed = 0x2545F491;
+
+	SnapshotStore() = default;
+	SnapshotStore(const SnapshotStore&) = delete;
+	SnapshotStore& operator=(const SnapshotStore&) = delete;
+	~SnapshotStore();
+
+	void linesReplaced(u32 line, u32 removed, u32 inserted) {
+		if (removed == 1 && inserted == 1 && !edits.empty()) {
+			const SnapshotEdit& last = edits.back();
+			if (last.line == line && last.removed == 1 && last.inserted == 1 && !last.ends) return;
+		}
+		edits.push_back({ line, removed, inserted });
+		if (edits.size() >= SNAPSHOT_EDIT_BATCH) applySnapshotEdits(*this);
+	}
+
+	// `count` lines borrowed from the mapping were appended at `line`, the
+	// first starting at lineStart and each ending at lineEnds[i].
+	void borrowedLinesAppended(u32 line, const char* data, u64 lineStart, const u64* lineEnds, u32 count) {
+		mappingData = data;
+		runEnds.emplace_back(lineEnds, lineEnds + count);
+		edits.push_back({ line, 0, count, runEnds.back().data(), lineStart });
+		if (edits.size() >= SNAPSHOT_EDIT_BATCH) applySnapshotEdits(*this);
+	}
+};
+
+// An immutable view of the text at one version. Taking one is O(1) when the
+// text has not changed and O((edits since the last one) * log n) otherwise;
+// snapshots share every node the edits between them did not touch.
+// It may be read and released on any thread, but must be released before
+// the TextBuffer it came from is destroyed: borrowed lines point into the
+// buffer's mapping.
+struct TextSnapshot {
+	SnapshotStore* store = nullptr;
+	SnapshotNode* root = nullptr;
+	u32 size = 0;
+	u64 version = 0;
+};
+
+// UI thread only, like every other TextBuffer call.
+TextSnapshot takeSnapshot(TextBuffer& text);
+
+// Another reference to the same snapshot, released separately.
+TextSnapshot shareSnapshot(const TextSnapshot& snapshot);
+
+void releaseSnapshot(TextSnapshot& snapshot);
+
+std::string_view snapshotLine(const TextSnapshot& snapshot, u32 index);
+
+// Reads lines in order starting anywhere: O(log n) to seek, then O(1)
+// amortized per line.
+struct SnapshotCursor {
+	std::vector<const SnapshotNode*> stack;
+	// Line within the node on top of the stack.
+	u32 offset = 0;
+	const char* mappingData = nullptr;
+};
+
+void seekSnapshotLine(SnapshotCursor& cursor, const TextSnapshot& snapshot, u32 index);
+
+// The line at the cursor, advancing past it; the cursor must not be at the
+// end.
+std::string_view nextSnapshotLine(SnapshotCursor& cursor);
@@ -0,0 +1,221 @@
+#include "traceExport.h"
+
+#if PROFILING
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "config.h"
+
+struct TraceEvent {
+	const char* name;
+	u64 ticks;
+	char ph;
+};
+
+// Single producer ring: the owning thread advances head, the writer tail.
+// A thread that exits gives its ring back for the next new thread once the
+// writer has emptied it; rings are never freed, so the writer can hold on
+// to them without locking.
+struct TraceThread {
+	u32 tid = 0;
+	const char* name = nullptr;
+	std::atomic<bool> owned{true};
+	std::atomic<u64> head{0};
+	std::atomic<u64> tail{0};
+	std::atomic<u64> dropped{0};
+	std::vector<TraceEvent> events = std::vector<TraceEvent>(TRACE_THREAD_EVENTS);
+	// Names of the begin events written without their end yet; writer only.
+	std::vector<const char*> open;
+};
+
+struct TraceWriter {
+	std::thread worker;
+	std::mutex lock;
+	std::condition_variable wake;
+	bool stopping = false;
+	FILE* file = nullptr;
+	u64 startTicks = 0;
+	f64 usPerTick = 0.0;
+	u64 lastTicks = 0;
+	bool first = true;
+};
+
+std::atomic<bool> g_tracing{false};
+
+static std::mutex g_threadsLock;
+static std::vector<TraceThread*> g_threads;
+static u32 g_nextTid = 1;
+static TraceWriter* g_writer = nullptr;
+static bool g_toggleRequested = false;
+
+static thread_local TraceThread* t_thread = nullptr;
+static thread_local const char* t_threadName = nullptr;
+
+struct TraceThreadRelease {
+	TraceThread* thread = nullptr;
+
+	~TraceThreadRelease() {
+		if (thread) thread->owned.store(false, std::memory_order_release);
+	}
+};
+
+static TraceThread* findTraceThread() {
+	std::lock_guard<std::mutex> guard(g_threadsLock);
+	for (TraceThread* thread : g_threads) {
+		if (thread->owned.load(std::memory_order_acquire)) continue;
+		if (thread->head.load(std::memory_order_relaxed) != thread->tail.load(std::memory_order_acquire)) continue;
+		thread->owned.store(true, std::memory_order_relaxed);
+		thread->name = t_threadName;
+		return thread;
+	}
+	TraceThread* thread = new TraceThread{};
+	thread->tid = g_nextTid++;
+	thread->name = t_threadName;
+	g_threads.push_back(thread);
+	return thread;
+}
+
+static TraceThread* acquireTraceThread() {
+	static thread_local TraceThreadRelease release;
+	release.thread = findTraceThread();
+	return release.thread;
+}
+
+void traceThreadName(const char* name) {
+	t_threadName = name;
+	if (t_thread) {
+		std::lock_guard<std::mutex> guard(g_threadsLock);
+		t_thread->name = name;
+	}
+}
+
+void traceEvent(const char* name, char ph, u64 ticks) {
+	if (!t_thread) t_thread = acquireTraceThread();
+	TraceThread& thread = *t_thread;
+	u64 head = thread.head.load(std::memory_order_relaxed);
+	if (head - thread.tail.load(std::memory_order_acquire) == thread.events.size()) {
+		thread.dropped.fetch_add(1, std::memory_order_relaxed);
+		return;
+	}
+	thread.events[head % thread.events.size()] = { name, ticks, ph };
+	thread.head.store(head + 1, std::memory_order_release);
+}
+
+static void writeEvent(TraceWriter& writer, const TraceEvent& event, u32 tid) {
+	f64 us = event.ticks > writer.startTicks ? (f64)(event.ticks - writer.startTicks) * writer.usPerTick : 0.0;
+	std::fprintf(writer.file, "%s\n{\"name\":\"%s\",\"ph\":\"%c\",\"ts\":%.3f,\"pid\":1,\"tid\":%u}",
+	             writer.first ? "" : ",", event.name, event.ph, us, tid);
+	writer.first = false;
+	writer.lastTicks = std::max(writer.lastTicks, event.ticks);
+}
+
+static void drainTraceThreads(TraceWriter& writer) {
+	std::vector<TraceThread*> threads;
+	{
+		std::lock_guard<std::mutex> guard(g_threadsLock);
+		threads = g_threads;
+	}
+	for (TraceThread* thread : threads) {
+		u64 tail = thread->tail.load(std::memory_order_relaxed);
+		u64 head = thread->head.load(std::memory_order_acquire);
+		for (u64 i = tail; i < head; i++) {
+			const TraceEvent& event = thread->events[i % thread->events.size()];
+			writeEvent(writer, event, thread->tid);
+			if (event.ph == 'B') thread->open.push_back(event.name);
+			else if (!thread->open.empty()) thread->open.pop_back();
+		}
+		thread->tail.store(head, std::memory_order_release);
+	}
+}
+
+static void finishTraceFile(TraceWriter& writer) {
+	u64 dropped = 0;
+	std::lock_guard<std::mutex> guard(g_threadsLock);
+	for (TraceThread* thread : g_threads) {
+		while (!thread->open.empty()) {
+			writeEvent(writer, { thread->open.back(), writer.lastTicks, 'E' }, thread->tid);
+			thread->open.pop_back();
+		}
+	}
+	for (TraceThread* thread : g_threads) {
+		dropped += thread->dropped.exchange(0, std::memory_order_relaxed);
+		if (!thread->name) continue;
+		std::fprintf(writer.file, "%s\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":\"%s\"}}",
+		             writer.first ? "" : ",", thread->tid, thread->name);
+		writer.first = false;
+	}
+	std::fprintf(writer.file, "\n],\n\"displayTimeUnit\":\"ms\",\n\"otherData\":{\"droppedEvents\":%llu}}\n",
+	             (unsigned long long)dropped);
+}
+
+static void runTraceWriter(TraceWriter* writer) {
+	traceThreadName("trace writer");
+	std::unique_lock<std::mutex> guard(writer->lock);
+	while (!writer->stopping) {
+		writer->wake.wait_for(guard, std::chrono::milliseconds(TRACE_FLUSH_MS), [writer]() { return writer->stopping; });
+		guard.unlock();
+		drainTraceThreads(*writer);
+		guard.lock();
+	}
+	drainTraceThreads(*writer);
+	finishTraceFile(*writer);
+	std::fclose(writer->file);
+}
+
+s16 startTrace(const std::string& path) {
+	if (g_writer) return OK;
+	FILE* file = std::fopen(path.c_str(), "wb");
+	if (!file) return ERR_IO;
+	std::fputs("{\"traceEvents\":[", file);
+
+	// Whatever a thread recorded after the last trace stopped is stale.
+	{
+		std::lock_guard<std::mutex> guard(g_threadsLock);
+		for (TraceThread* thread : g_threads) {
+			thread->tail.store(thread->head.load(std::memory_order_acquire), std::memory_order_release);
+			thread->dropped.store(0, std::memory_order_relaxed);
+			thread->open.clear();
+		}
+	}
+
+	TraceWriter* writer = new TraceWriter{};
+	writer->file = file;
+	writer->startTicks = SDL_GetPerformanceCounter();
+	writer->usPerTick = 1e6 / (f64)SDL_GetPerformanceFrequency();
+	writer->worker = std::thread(runTraceWriter, writer);
+	g_writer = writer;
+	g_tracing.store(true, std::memory_order_relaxed);
+	return OK;
+}
+
+void stopTrace() {
+	TraceWriter* writer = g_writer;
+	if (!writer) return;
+	g_tracing.store(false, std::memory_order_relaxed);
+	{
+		std::lock_guard<std::mutex> guard(writer->lock);
+		writer->stopping = true;
+	}
+	writer->wake.notify_one();
+	writer->worker.join();
+	delete writer;
+	g_writer = nullptr;
+}
+
+void requestTraceToggle() {
+	g_toggleRequested = true;
+}
+
+void pumpTraceToggle() {
+	if (!g_toggleRequested) return;
+	g_toggleRequested = false;
+	if (g_writer) stopTrace();
+	else if (startTrace(TRACE_PATH) != OK) std::fprintf(stderr, "could not open %s\n", TRACE_PATH);
+}
+
+#endif
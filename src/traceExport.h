@@ -0,0 +1,69 @@
+#pragma once
+#include <string>
+
+#include "commonTypes.h"
+
+#if PROFILING
+#include <atomic>
+#include <SDL.h>
+#endif
+
+#define PROFILE_JOIN2(a, b) a##b
+#define PROFILE_JOIN(a, b) PROFILE_JOIN2(a, b)
+
+// Chrome Trace Event export, in builds with PROFILING. While a trace runs,
+// PROFILE_SCOPE and TRACE_SCOPE append begin/end events to a ring owned by
+// the thread they run on, and a writer thread drains the rings into the
+// JSON file every TRACE_FLUSH_MS; the threads being traced never touch the
+// file. Event and thread names must be string literals.
+#if PROFILING
+
+extern std::atomic<bool> g_tracing;
+
+inline bool tracing() { return g_tracing.load(std::memory_order_relaxed); }
+
+// ph is 'B' or 'E'; ticks come from SDL_GetPerformanceCounter.
+void traceEvent(const char* name, char ph, u64 ticks);
+
+// Names the calling thread in traces. Cheap enough to call whether or not
+// a trace is running.
+void traceThreadName(const char* name);
+
+// Starts writing a trace to path; returns ERR_IO if it cannot be opened.
+s16 startTrace(const std::string& path);
+
+// Writes what is left and closes the file. Safe when no trace is running.
+// Scopes still open on other threads are closed at the last event written.
+void stopTrace();
+
+// F4 only asks for the trace to start or stop; pumpTraceToggle does it from
+// the main loop, where none of the UI thread's own scopes is open.
+void requestTraceToggle();
+void pumpTraceToggle();
+
+struct TraceScope {
+	const char* name;
+	bool traced;
+
+	explicit TraceScope(const char* name) : name(name), traced(tracing()) {
+		if (traced) traceEvent(name, 'B', SDL_GetPerformanceCounter());
+	}
+	~TraceScope() {
+		if (traced) traceEvent(name, 'E', SDL_GetPerformanceCounter());
+	}
+	TraceScope(const TraceScope&) = delete;
+	TraceScope& operator=(const TraceScope&) = delete;
+};
+
+#define TRACE_SCOPE(name) TraceScope PROFILE_JOIN(traceScope, __LINE__){ name }
+#define TRACE_THREAD_NAME(name) traceThreadName(name)
+
+#else
+
+inline void stopTrace() {}
+inline void pumpTraceToggle() {}
+
+#define TRACE_SCOPE(name) ((void)0)
+#define TRACE_THREAD_NAME(name) ((void)0)
+
+#endif
@@ -0,0 +1,357 @@
+#include "undoJournal.h"
+#include "config.h"
+#include "eventHandlers.h"
+#include "fileLoader.h"
+#include "recoveryLog.h"
+#include "render.h"
+#include "search.h"
+#include "syntaxHighlight.h"
+
+#include <algorithm>
+#include <string>
+
+constexpr u32 JOURNAL_CHUNK_SIZE = 64 * 1024;
+
+UndoJournal::~UndoJournal() {
+	clearUndoJournal(*this);
+}
+
+static JournalChunk& chunkAt(UndoJournal& journal, u32 chunk) {
+	return journal.chunks[chunk - journal.firstChunk];
+}
+
+static std::string_view recordText(UndoJournal& journal, const EditRecord& record) {
+	if (record.length == 0) return {};
+	return std::string_view(chunkAt(journal, record.chunk).data + record.offset, record.length);
+}
+
+static size_t journalBytes(const UndoJournal& journal) {
+	return journal.records.size() * sizeof(EditRecord) + journal.chunkBytes;
+}
+
+// Bump-allocates len bytes, opening a new chunk when the last one is full.
+// Texts larger than a chunk get a chunk of their own.
+static char* allocateText(UndoJournal& journal, u32 len, u32& chunk, u32& offset) {
+	if (journal.chunks.empty() || journal.chunks.back().capacity - journal.chunks.back().used < len) {
+		u32 capacity = std::max(len, JOURNAL_CHUNK_SIZE);
+		journal.chunks.push_back({ new char[capacity], capacity, 0 });
+		journal.chunkBytes += capacity;
+	}
+	JournalChunk& last = journal.chunks.back();
+	chunk = journal.firstChunk + (u32)journal.chunks.size() - 1;
+	offset = last.used;
+	last.used += len;
+	return last.data + offset;
+}
+
+// Forgets everything that could have been redone; text stored after the
+// newest remaining record goes back to the chunks.
+static void dropRedo(UndoJournal& journal) {
+	if (journal.applied == journal.records.size()) return;
+	journal.records.resize(journal.applied);
+	journal.sealed = true;
+
+	u32 keepChunk = journal.firstChunk;
+	u32 keepUsed = 0;
+	for (size_t i = journal.records.size(); i > 0; i--) {
+		const EditRecord& record = journal.records[i - 1];
+		if (record.length == 0) continue;
+		keepChunk = record.chunk;
+		keepUsed = record.offset + record.length;
+		break;
+	}
+	while (!journal.chunks.empty() && journal.firstChunk + journal.chunks.size() - 1 > keepChunk) {
+		journal.chunkBytes -= journal.chunks.back().capacity;
+		delete[] journal.chunks.back().data;
+		journal.chunks.pop_back();
+	}
+	if (!journal.chunks.empty()) journal.chunks.back().used = keepUsed;
+}
+
+// Drops the oldest records, and the chunks only they used, until the
+// journal fits its budget again.
+static void trimJournal(UndoJournal& journal) {
+	while (journalBytes(journal) > UNDO_JOURNAL_BYTES && journal.applied > 1) {
+		// Whole groups go, so no undo step is left half there.
+		u32 group = journal.records.front().group;
+		do {
+			journal.records.pop_front();
+			journal.applied--;
+		} while (journal.applied > 1 && journal.records.front().group == group);
+
+		u32 oldestChunk = journal.firstChunk + (u32)journal.chunks.size() - 1;
+		for (const EditRecord& record : journal.records) {
+			if (record.length == 0) continue;
+			oldestChunk = record.chunk;
+			break;
+		}
+		while (journal.firstChunk < oldestChunk) {
+			journal.chunkBytes -= journal.chunks.front().capacity;
+			delete[] journal.chunks.front().data;
+			journal.chunks.pop_front();
+			journal.firstChunk++;
+		}
+	}
+}
+
+static void pushRecord(EditorState& st, EditKind kind, u32 line, u32 column, std::string_view text) {
+	UndoJournal& journal = st.Undo;
+	EditRecord record{};
+	record.kind = kind;
+	record.line = line;
+	record.column = column;
+	record.cursorLine = st.CurrLine;
+	record.cursorPos = st.CursorPos;
+	record.group = journal.groupDepth ? journal.currentGroup : journal.nextGroup++;
+	if (!text.empty()) {
+		record.length = (u32)text.size();
+		char* dst = allocateText(journal, record.length, record.chunk, record.offset);
+		std::copy_n(text.data(), text.size(), dst);
+	}
+	journal.records.push_back(record);
+	journal.applied = journal.records.size();
+	trimJournal(journal);
+}
+
+// The newest record's text can grow in place only while it sits at the end
+// of the last chunk and there is room behind it.
+static bool canExtend(UndoJournal& journal, const EditRecord& record, u32 len) {
+	if (journal.chunks.empty() || record.length == 0) return false;
+	const JournalChunk& last = journal.chunks.back();
+	if (record.chunk != journal.firstChunk + journal.chunks.size() - 1) return false;
+	return record.offset + record.length == last.used && last.capacity - last.used >= len;
+}
+
+static void extendRecord(UndoJournal& journal, EditRecord& record, std::string_view text) {
+	JournalChunk& last = journal.chunks.back();
+	std::copy_n(text.data(), text.size(), last.data + last.used);
+	last.used += (u32)text.size();
+	record.length += (u32)text.size();
+}
+
+// Every edit reaches the recovery log, the snapshot store, the search index
+// and the highlight cache from here.
+static void noteEdit(EditorState& st, RecoveryOp op, u32 line, u32 column, std::string_view text = {}) {
+	logEdit(st, op, line, column, text);
+	if (op != LogJoinLine && op != LogInsertLine && op != LogRemoveLine) st.Text->lineEdited(line);
+
+	u32 newlines = (u32)std::count(text.begin(), text.end(), '\n');
+	u32 removed = 1, inserted = 1;
+	switch (op) {
+		case LogSplitLine: inserted = 2; break;
+		case LogJoinLine: removed = 2; break;
+		case LogInsertLine: removed = 0; break;
+		case LogRemoveLine: inserted = 0; break;
+		case LogInsertBlock: inserted += newlines; break;
+		case LogRemoveBlock: removed += newlines; break;
+		default: break;
+	}
+	searchLinesReplaced(st, line, removed, inserted);
+	highlightLinesReplaced(st, line, removed, inserted);
+}
+
+void recordInsertText(EditorState& st, u32 line, u32 column, std::string_view text) {
+	if (text.empty()) return;
+	noteEdit(st, LogInsertText, line, column, text);
+	UndoJournal& journal = st.Undo;
+	dropRedo(journal);
+
+	if (!journal.sealed && !journal.records.empty()) {
+		EditRecord& last = journal.records.back();
+		if (last.kind == EditInsertText && last.line == line && last.column + last.length == column && canExtend(journal, last, (u32)text.size())) {
+			extendRecord(journal, last, text);
+			return;
+		}
+	}
+	pushRecord(st, EditInsertText, line, column, text);
+	journal.sealed = false;
+}
+
+void recordRemoveText(EditorState& st, u32 line, u32 column, std::string_view text) {
+	if (text.empty()) return;
+	noteEdit(st, LogRemoveText, line, column, text);
+	UndoJournal& journal = st.Undo;
+	dropRedo(journal);
+
+	if (!journal.sealed && !journal.records.empty() && text.size() == 1) {
+		EditRecord& last = journal.records.back();
+		bool sameLine = last.kind == EditRemoveText && last.line == line && canExtend(journal, last, 1);
+		// Repeated deletes at one column (x x x) and backspaces walking left.
+		if (sameLine && !last.backward && last.column == column) {
+			extendRecord(journal, last, text);
+			return;
+		}
+		if (sameLine && (last.backward || last.length == 1) && column + 1 == last.column) {
+			extendRecord(journal, last, text);
+			last.column = column;
+			last.backward = true;
+			return;
+		}
+	}
+	pushRecord(st, EditRemoveText, line, column, text);
+	journal.sealed = false;
+}
+
+void recordSplitLine(EditorState& st, u32 line, u32 column) {
+	noteEdit(st, LogSplitLine, line, column);
+	dropRedo(st.Undo);
+	pushRecord(st, EditSplitLine, line, column, {});
+	st.Undo.sealed = true;
+}
+
+void recordInsertLine(EditorState& st, u32 line) {
+	noteEdit(st, LogInsertLine, line, 0);
+	dropRedo(st.Undo);
+	pushRecord(st, EditInsertLine, line, 0, {});
+	st.Undo.sealed = true;
+}
+
+void recordInsertBlock(EditorState& st, u32 line, u32 column, std::string_view text) {
+	if (text.empty()) return;
+	noteEdit(st, LogInsertBlock, line, column, text);
+	dropRedo(st.Undo);
+	pushRecord(st, EditInsertBlock, line, column, text);
+	st.Undo.sealed = true;
+}
+
+void sealUndoRun(EditorState& st) {
+	st.Undo.sealed = true;
+}
+
+void beginUndoGroup(EditorState& st) {
+	UndoJournal& journal = st.Undo;
+	if (journal.groupDepth++ == 0) journal.currentGroup = journal.nextGroup++;
+	journal.sealed = true;
+}
+
+void endUndoGroup(EditorState& st) {
+	UndoJournal& journal = st.Undo;
+	if (journal.groupDepth > 0) journal.groupDepth--;
+	journal.sealed = true;
+}
+
+static bool addsOrRemovesLines(const EditRecord& record) {
+	return record.kind == EditSplitLine || record.kind == EditInsertLine || record.kind == EditInsertBlock;
+}
+
+static std::string forwardText(UndoJournal& journal, const EditRecord& record) {
+	std::string text(recordText(journal, record));
+	if (record.backward) std::reverse(text.begin(), text.end());
+	return text;
+}
+
+static void undoRecord(EditorState& st, const EditRecord& record) {
+	UndoJournal& journal = st.Undo;
+	if (addsOrRemovesLines(record)) finishFileLoad(st);
+
+	switch (record.kind) {
+		case EditInsertText:
+			noteEdit(st, LogRemoveText, record.line, record.column, recordText(journal, record));
+			st.Text->getLineBuffer(record.line)->removeRange(record.column, record.length);
+			markLineDirty(st, record.line);
+			break;
+		case EditRemoveText: {
+			std::string text = forwardText(journal, record);
+			noteEdit(st, LogInsertText, record.line, record.column, text);
+			st.Text->getLineBuffer(record.line)->insertText(record.column, text);
+			markLineDirty(st, record.line);
+		} break;
+		case EditSplitLine:
+			noteEdit(st, LogJoinLine, record.line, record.column);
+			st.Text->joinAtIndex(record.line);
+			markLinesDirtyFrom(st, record.line);
+			break;
+		case EditInsertLine:
+			noteEdit(st, LogRemoveLine, record.line, 0);
+			st.Text->removeAtIndex(record.line);
+			markLinesDirtyFrom(st, record.line);
+			break;
+		case EditInsertBlock: {
+			std::string_view text = recordText(journal, record);
+			noteEdit(st, LogRemoveBlock, record.line, record.column, text);
+			st.Text->removeBlock(record.line, record.column, text);
+			markLinesDirtyFrom(st, record.line);
+		} break;
+	}
+	moveCursorTo(st, record.cursorLine, record.cursorPos);
+}
+
+s16 undoEdit(EditorState& st) {
+	UndoJournal& journal = st.Undo;
+	if (journal.applied == 0) return ERR_EOF;
+	journal.sealed = true;
+	u32 group = journal.records[journal.applied - 1].group;
+	do {
+		undoRecord(st, journal.records[--journal.applied]);
+	} while (journal.applied > 0 && journal.records[journal.applied - 1].group == group);
+	st.isDirty = true;
+	return OK;
+}
+
+static void redoRecord(EditorState& st, const EditRecord& record) {
+	UndoJournal& journal = st.Undo;
+	if (addsOrRemovesLines(record)) finishFileLoad(st);
+
+	u32 cursorLine = record.line, cursorPos = record.column;
+	switch (record.kind) {
+		case EditInsertText: {
+			std::string text = forwardText(journal, record);
+			noteEdit(st, LogInsertText, record.line, record.column, text);
+			st.Text->getLineBuffer(record.line)->insertText(record.column, text);
+			markLineDirty(st, record.line);
+			cursorPos += record.length;
+		} break;
+		case EditRemoveText:
+			noteEdit(st, LogRemoveText, record.line, record.column, recordText(journal, record));
+			st.Text->getLineBuffer(record.line)->removeRange(record.column, record.length);
+			markLineDirty(st, record.line);
+			break;
+		case EditSplitLine: {
+			noteEdit(st, LogSplitLine, record.line, record.column);
+			st.Text->insertAtIndex(record.line + 1);
+			LineBuffer* lb = st.Text->getLineBuffer(record.line);
+			lb->splitAt(record.column, lb->next);
+			markLinesDirtyFrom(st, record.line);
+			cursorLine = record.line + 1;
+			cursorPos = 0;
+		} break;
+		case EditInsertLine:
+			noteEdit(st, LogInsertLine, record.line, 0);
+			st.Text->insertAtIndex(record.line);
+			markLinesDirtyFrom(st, record.line);
+			break;
+		case EditInsertBlock: {
+			std::string_view text = recordText(journal, record);
+			noteEdit(st, LogInsertBlock, record.line, record.column, text);
+			st.Text->insertBlock(record.line, record.column, text);
+			markLinesDirtyFrom(st, record.line);
+			size_t lastNewline = text.rfind('\n');
+			cursorLine = record.line + (u32)std::count(text.begin(), text.end(), '\n');
+			cursorPos = lastNewline == std::string_view::npos ? record.column + record.length : (u32)(text.size() - lastNewline - 1);
+		} break;
+	}
+	moveCursorTo(st, cursorLine, cursorPos);
+}
+
+s16 redoEdit(EditorState& st) {
+	UndoJournal& journal = st.Undo;
+	if (journal.applied == journal.records.size()) return ERR_EOF;
+	journal.sealed = true;
+	u32 group = journal.records[journal.applied].group;
+	do {
+		redoRecord(st, journal.records[journal.applied++]);
+	} while (journal.applied < journal.records.size() && journal.records[journal.applied].group == group);
+	st.isDirty = true;
+	return OK;
+}
+
+void clearUndoJournal(UndoJournal& journal) {
+	for (JournalChunk& chunk : journal.chunks) delete[] chunk.data;
+	journal.chunks.clear();
+	journal.chunkBytes = 0;
+	journal.records.clear();
+	journal.applied = 0;
+	journal.sealed = true;
+	journal.firstChunk = 0;
+	journal.groupDepth = 0;
+}
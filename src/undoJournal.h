@@ -0,0 +1,81 @@
+#pragma once
+#include <deque>
+#include <string_view>
+
+#include "commonTypes.h"
+
+struct EditorState;
+
+enum EditKind : u8 {
+	EditInsertText = 0, EditRemoveText = 1, EditSplitLine = 2, EditInsertLine = 3, EditInsertBlock = 4
+};
+
+// One reversible edit. Text edits keep their characters in the journal's
+// chunks; a backspace run stores them last-deleted first, hence `backward`.
+// A block is text with newlines, such as a paste, kept as one record
+// however many lines it spans. cursorLine/cursorPos is where the cursor was
+// before the edit. Records sharing a group are undone and redone together.
+struct EditRecord {
+	EditKind kind = EditInsertText;
+	bool backward = false;
+	u32 line = 0, column = 0;
+	u32 length = 0;
+	u32 chunk = 0, offset = 0;
+	u32 cursorLine = 0, cursorPos = 0;
+	u32 group = 0;
+};
+
+struct JournalChunk {
+	char* data;
+	u32 capacity;
+	u32 used;
+};
+
+// Append-only edit log. records[0, applied) are in the buffer and can be
+// undone, records[applied, size) were undone and can be redone. Record text
+// is bump-allocated from chunks numbered from firstChunk, which are freed
+// from the front once the oldest records are dropped to stay within
+// UNDO_JOURNAL_BYTES.
+struct UndoJournal {
+	std::deque<EditRecord> records;
+	size_t applied = 0;
+	bool sealed = true;
+
+	// While groupDepth > 0 every record joins currentGroup; otherwise each
+	// one is a group of its own.
+	u32 groupDepth = 0;
+	u32 currentGroup = 0;
+	u32 nextGroup = 1;
+
+	std::deque<JournalChunk> chunks;
+	u32 firstChunk = 0;
+	size_t chunkBytes = 0;
+
+	~UndoJournal();
+};
+
+void recordInsertText(EditorState& st, u32 line, u32 column, std::string_view text);
+
+void recordRemoveText(EditorState& st, u32 line, u32 column, std::string_view text);
+
+void recordSplitLine(EditorState& st, u32 line, u32 column);
+
+void recordInsertLine(EditorState& st, u32 line);
+
+void recordInsertBlock(EditorState& st, u32 line, u32 column, std::string_view text);
+
+// Ends the current typing run; the next edit starts a new record.
+void sealUndoRun(EditorState& st);
+
+// Everything recorded between the outermost begin and its end is one undo
+// step, e.g. an insert session. Both seal the current run.
+void beginUndoGroup(EditorState& st);
+void endUndoGroup(EditorState& st);
+
+// Undo a whole group. Both cost O(size of the edits) plus O(log n) per
+// line added or removed.
+s16 undoEdit(EditorState& st);
+
+s16 redoEdit(EditorState& st);
+
+void clearUndoJournal(UndoJournal& journal);